@@ -1,25 +1,404 @@
+#include <climits>
 
 #include "m65816.hpp"
 #include "bt.hpp"
 
 // ---------------------------------------------------------------------------
 //lint -estring(823,BTWALK_PREAMBLE) definition of macro ends in semi-colon
-#define BTWALK_PREAMBLE(walker_ea, opcode_var, itype_var) \
-  (walker_ea) = prev_head((walker_ea), (walker_ea) - 4);  \
+#define BTWALK_PREAMBLE(heads, walker_ea, opcode_var, itype_var) \
+  (walker_ea) = (heads).prev((walker_ea), (walker_ea) - 4); \
   if ( (walker_ea) == BADADDR )                           \
     break;                                                \
-  flags64_t F = get_flags(walker_ea);               \
-  if ( is_func(F) || !is_code(F) )                          \
+  if ( (heads).is_func_start(walker_ea) || !(heads).is_code(walker_ea) ) \
     break;                                                \
   opcode_var = get_byte(walker_ea);                       \
   itype_var = get_opcode_info(opcode_var).itype;
 
+// What one instruction means for the value being searched for
+enum bt_step_t
+{
+	BTR_NEXT,    // Nothing, keep walking up
+	BTR_VALUE,   // The value is known
+	BTR_UNKNOWN, // The value can't be determined
+	BTR_FOLLOW   // The value comes from somewhere else: see 'follow'
+};
+
+// A query: the (size * 8)-bits value held in 'source' at 'ea'.
+// For BT_STACK, it sits under 'depth' bytes.
+struct bt_query_t
+{
+	ea_t ea;
+	uint8 size;
+	btsource_t source;
+	uint8 depth;
+};
+
 // ---------------------------------------------------------------------------
+// Bytes an instruction pushes on the stack (negative: pulls), with the
+// M/X width at 'ea'. Calls are taken to be balanced.
+static int bt_stack_delta(ea_t ea, uint8 itype)
+{
+	switch (itype)
+	{
+	case M65816_pea:
+	case M65816_pei:
+	case M65816_per:
+	case M65816_phd:
+		return 2;
+	case M65816_phb:
+	case M65816_phk:
+	case M65816_php:
+		return 1;
+	case M65816_pha:
+		return is_acc_16_bits(ea) ? 2 : 1;
+	case M65816_phx:
+	case M65816_phy:
+		return is_xy_16_bits(ea) ? 2 : 1;
+	case M65816_pld:
+		return -2;
+	case M65816_plb:
+	case M65816_plp:
+		return -1;
+	case M65816_pla:
+		return is_acc_16_bits(ea) ? -2 : -1;
+	case M65816_plx:
+	case M65816_ply:
+		return is_xy_16_bits(ea) ? -2 : -1;
+	}
+	return 0;
+}
+
+// ---------------------------------------------------------------------------
+// The instruction at 'ea' is 'insn_size' bytes long, and we're looking
+// for the value of 'q' right after it.
+//
 // FIXME: The following are lacks in implementation:
 // * If the value we asked for is 16bits, and
 //   at some point we are reduced to an 8-bits one, we should
 //   fail.
-int32 backtrack_value(ea_t from_ea, uint8 size, btsource_t source)
+static bt_step_t bt_step(ea_t ea, asize_t insn_size, const bt_query_t& q, int32* val, bt_query_t* follow)
+{
+	uint8 opcode = get_byte(ea);
+	uint8 itype = get_opcode_info(opcode).itype;
+
+	follow->ea = ea;
+	follow->size = q.size;
+	follow->source = q.source;
+	follow->depth = q.depth;
+
+	switch (q.source)
+	{
+	case BT_STACK:
+	{
+		if (itype == M65816_tcs || itype == M65816_txs)
+			return BTR_UNKNOWN; // S gets reloaded
+
+		// Before a pull, the value was that much deeper. Before a
+		// push that doesn't reach it, that much less deep.
+		int delta = bt_stack_delta(ea, itype);
+		if (delta == 0)
+			return BTR_NEXT;
+		if (delta < 0 || q.depth >= delta)
+		{
+			int depth = q.depth - delta;
+			if (depth > BT_MAX_STACK_DEPTH)
+				return BTR_UNKNOWN;
+			follow->depth = uint8(depth);
+			return BTR_NEXT;
+		}
+
+		// This pushes the value; or part of it, if it also
+		// sits on something pushed before
+		if (q.depth + q.size > delta)
+			return BTR_UNKNOWN;
+
+		sel_t pushed;
+		switch (itype)
+		{
+		case M65816_pea:    // Push effective absolute address
+			pushed = get_word(ea + 1);
+			break;
+		case M65816_per:    // Push effective PC-relative indirect address
+			pushed = uint16(ea + 3 + get_word(ea + 1));
+			break;
+		case M65816_phb:    // Push B (data bank register)
+			pushed = get_cpu_mode(ea).db;
+			break;
+		case M65816_phd:    // Push D (direct page register)
+			pushed = get_cpu_mode(ea).dp;
+			break;
+		case M65816_phk:    // Push K (program bank register)
+			pushed = get_cpu_mode(ea).pb;
+			break;
+		case M65816_pha:    // Push A
+		case M65816_phx:    // Push X
+		case M65816_phy:    // Push Y
+			// Only the low bytes of a register can be followed
+			if (q.depth != 0)
+				return BTR_UNKNOWN;
+			follow->source = itype == M65816_pha ? BT_A
+				: itype == M65816_phx ? BT_X
+				: BT_Y;
+			follow->depth = 0;
+			return BTR_FOLLOW;
+		default:            // PEI, PHP
+			return BTR_UNKNOWN;
+		}
+		if (pushed == BADSEL)
+			return BTR_UNKNOWN;
+
+		// The stack grows down: the lowest byte is on top
+		*val = int32((pushed >> (8 * q.depth)) & (q.size == 1 ? 0xff : 0xffff));
+		return BTR_VALUE;
+	}
+
+	case BT_A:
+	{
+		uint8 new_size = is_acc_16_bits(ea) ? 2 : 1;
+		switch (itype)
+		{
+			// All these modify A in a way we cannot
+			// easily determine its value anymore.
+			// We'll thus stop.
+		case M65816_adc:    // Add with carry
+		case M65816_and:    // AND A with memory
+		case M65816_asl:    // Shift memory or A left
+		case M65816_dec:    // Decrement
+		case M65816_eor:    // XOR A with M
+		case M65816_inc:    // Increment
+		case M65816_mvn:    // Block move next
+		case M65816_mvp:    // Block move prev
+		case M65816_ora:    // Or A with memory
+		case M65816_sbc:    // Subtract with borrow from A
+		case M65816_xba:    // Exchange bytes in A
+			return BTR_UNKNOWN;
+			// For these next ones, there's hope.
+		case M65816_lsr:    // Logical shift memory or A right
+			if (opcode == 0x4a) // LSR    A
+				return BTR_UNKNOWN;
+			break;
+		case M65816_rol:    // Rotate memory or A left
+		case M65816_ror:    // Rotate memory or A right
+			if (opcode == 0x30 || opcode == 0x70)
+				return BTR_UNKNOWN;
+			break;
+		case M65816_lda:    // Load A from memory
+			if (opcode != 0xa9) // LDA    imm
+				return BTR_UNKNOWN;
+			*val = insn_size == 3 ? get_word(ea + 1) : get_byte(ea + 1);
+			return BTR_VALUE;
+		case M65816_pla:    // Pull A
+			follow->source = BT_STACK;
+			follow->size = new_size;
+			follow->depth = 0;
+			return BTR_FOLLOW;
+		case M65816_tdc:    // Transfer 16-bit D to A
+			*val = get_cpu_mode(ea).dp;
+			return BTR_VALUE;
+		case M65816_tsc:    // Transfer S to A
+			*val = get_sreg(ea, rS);
+			return BTR_VALUE;
+		case M65816_txa:    // Transfer X to A
+			follow->source = BT_X;
+			follow->size = new_size;
+			return BTR_FOLLOW;
+		case M65816_tya:    // Transfer Y to A
+			follow->source = BT_Y;
+			follow->size = new_size;
+			return BTR_FOLLOW;
+		}
+		return BTR_NEXT;
+	}
+
+	case BT_X:
+	{
+		uint8 new_size = is_xy_16_bits(ea) ? 2 : 1;
+		switch (itype)
+		{
+			// All these modify X in a way we cannot
+			// easily determine its value anymore.
+			// We'll thus stop.
+		case M65816_dex:    // Decrement X
+		case M65816_inx:    // Increment X
+		case M65816_mvn:    // Block move next
+		case M65816_mvp:    // Block move prev
+			return BTR_UNKNOWN;
+		case M65816_ldx:    // Load X from memory
+			if (opcode != 0xa2) // LDX    imm
+				return BTR_UNKNOWN;
+			*val = insn_size == 3 ? get_word(ea + 1) : get_byte(ea + 1);
+			return BTR_VALUE;
+		case M65816_plx:    // Pull X
+			follow->source = BT_STACK;
+			follow->size = new_size;
+			follow->depth = 0;
+			return BTR_FOLLOW;
+		case M65816_tax:    // Transfer A to X
+			follow->source = BT_A;
+			follow->size = new_size;
+			return BTR_FOLLOW;
+		case M65816_tsx:    // Transfer S to X
+			*val = get_sreg(ea, rS);
+			return BTR_VALUE;
+		case M65816_tyx:    // Transfer Y to X
+			follow->source = BT_Y;
+			follow->size = new_size;
+			return BTR_FOLLOW;
+		}
+		return BTR_NEXT;
+	}
+
+	case BT_Y:
+	{
+		uint8 new_size = is_xy_16_bits(ea) ? 2 : 1;
+		switch (itype)
+		{
+			// All these modify Y in a way we cannot
+			// easily determine its value anymore.
+			// We'll thus stop.
+		case M65816_dey:    // Decrement Y
+		case M65816_iny:    // Increment Y
+		case M65816_mvn:    // Block move next
+		case M65816_mvp:    // Block move prev
+			return BTR_UNKNOWN;
+		case M65816_ldy:    // Load Y from memory
+			if (opcode != 0xa0) // LDY    imm
+				return BTR_UNKNOWN;
+			*val = insn_size == 3 ? get_word(ea + 1) : get_byte(ea + 1);
+			return BTR_VALUE;
+		case M65816_ply:    // Pull Y
+			follow->source = BT_STACK;
+			follow->size = new_size;
+			follow->depth = 0;
+			return BTR_FOLLOW;
+		case M65816_tay:    // Transfer A to Y
+			follow->source = BT_A;
+			follow->size = new_size;
+			return BTR_FOLLOW;
+		case M65816_txy:    // Transfer X to Y
+			follow->source = BT_X;
+			follow->size = new_size;
+			return BTR_FOLLOW;
+		}
+		return BTR_NEXT;
+	}
+
+	case BT_DP:
+		switch (itype)
+		{
+		case M65816_pld:    // Pull D
+			follow->source = BT_STACK;
+			follow->depth = 0;
+			return BTR_FOLLOW;
+		case M65816_tcd:    // Transfer 16-bit Accumulator to Direct Page Register
+			follow->source = BT_A;
+			return BTR_FOLLOW;
+		}
+		return BTR_NEXT;
+
+	default:
+		msg("WARNING: backtrack_value() of unsupported BT-type: %d\n", q.source);
+		return BTR_UNKNOWN;
+	}
+}
+
+// ---------------------------------------------------------------------------
+// A query being walked
+struct bt_frame_t
+{
+	bt_query_t q;
+	ea_t at;                     // Looking at what runs before 'at'
+	uint8 depth;                 // BT_STACK: depth of the value at 'at'
+	bt_pages_t pages;            // Addresses looked at
+	bool forked = false;         // Done walking, now meeting 'pending'
+	qvector<bt_query_t> pending; // One per path, once the walk forked
+	size_t next = 0;
+	bool have = false;           // 'val' holds the meet so far
+	int32 val = -1;
+	bt_stop_t stop = BTS_FOLLOW; // BTS_FOLLOW until there's a result
+	int cycle = INT_MAX;         // Lowest open frame this depends on
+};
+
+// ---------------------------------------------------------------------------
+// Meet of the value along one more path into 'f': all paths
+// have to agree.
+static void bt_meet(bt_frame_t& f, bt_stop_t stop, int32 val)
+{
+	if (stop != BTS_VALUE)
+	{
+		f.stop = stop;
+	}
+	else if (!f.have)
+	{
+		f.have = true;
+		f.val = val;
+	}
+	else if (f.val != val)
+	{
+		f.stop = BTS_UNKNOWN;
+	}
+}
+
+// ---------------------------------------------------------------------------
+// Instructions that may run right before 'ea': the previous one, if it
+// flows into it, and jumps and branches to it. Calls aren't followed.
+static void bt_preds(ea_t ea, eavec_t* preds)
+{
+	preds->clear();
+	xrefblk_t xb;
+	for (bool ok = xb.first_to(ea, XREF_ALL); ok; ok = xb.next_to())
+	{
+		if (xb.iscode && xb.type != fl_CF && xb.type != fl_CN)
+			preds->push_back(xb.from);
+	}
+}
+
+// ---------------------------------------------------------------------------
+// Answers a query by walking up through the predecessors of each
+// instruction. Where the walk forks, each path becomes a query of its
+// own, and their results are met. The queries waiting on others are
+// kept on an explicit stack rather than recursing.
+//
+// A path leading back to a query that is still open (a loop) doesn't
+// bring anything new, and is left out of the meet. A value found that
+// way is only right once the open query is answered, so it isn't
+// memoized before then.
+struct bt_engine_t
+{
+	m65816_t& pm;
+	uint32 budget;
+	uint32 walked = 0;
+	qvector<bt_frame_t> stack;
+	std::map<uint64, int> open; // Index of the queries on 'stack'
+	eavec_t preds;
+
+	bt_engine_t(m65816_t& _pm) : pm(_pm), budget(_pm.bt_budget) {}
+
+	static uint64 key(const bt_query_t& q)
+	{
+		return (uint64(q.ea) << 16) | (uint64(q.depth) << 8) | (uint64(q.size) << 4) | uint64(q.source);
+	}
+
+	void push(const bt_query_t& q);
+	void walk(bt_frame_t& f);
+	void next(bt_frame_t& f);
+	bt_stop_t run(const bt_query_t& q, int32* val);
+};
+
+// ---------------------------------------------------------------------------
+void bt_engine_t::push(const bt_query_t& q)
+{
+	open[key(q)] = int(stack.size());
+	bt_frame_t& f = stack.push_back();
+	f.q = q;
+	f.at = q.ea;
+	f.depth = q.depth;
+	bt_add_pages(f.pages, q.ea, q.ea + 1);
+}
+
+// ---------------------------------------------------------------------------
+// Walk up from 'f.at', until there's a result or the walk forks
+void bt_engine_t::walk(bt_frame_t& f)
 {
 	// Note: At some point, we were using:
 	// ---
@@ -107,209 +486,194 @@ int32 backtrack_value(ea_t from_ea, uint8 size, btsource_t source)
 	// appears below.
 	// Which also makes me think.. should we propagate from a BNE?
 
-	uint8 opcode;
-	ea_t cur_ea = from_ea;
-	uint8 itype;
-	switch (source)
+	while (true)
 	{
-	case BT_STACK:
-		while (true)
+		if (walked >= budget)
 		{
-			BTWALK_PREAMBLE(cur_ea, opcode, itype);
-			if (M65_ITYPE_PUSH(itype))
-			{
-				switch (itype)
-				{
-				case M65816_pea:    // Push effective absolute address
-				{
-					uint16 val = get_word(cur_ea + 1);
-					if (size == 1)
-						val &= 0xff;
-					return val;
-				}
-				case M65816_pei:    // Push effective indirect address
-					return -1;
-				case M65816_per:    // Push effective PC-relative indirect address
-				{
-					uint16 val = cur_ea + 3;
-					val += get_word(cur_ea + 1);
-					val &= (size == 1 ? 0xff : 0xffff);
-					return val;
-				}
-				case M65816_pha:    // Push A
-					return backtrack_value(cur_ea, size, BT_A);
-				case M65816_phb:    // Push B (data bank register)
-					return get_sreg(cur_ea, rB);
-				case M65816_phd:    // Push D (direct page register)
-					return get_sreg(cur_ea, rD);
-				case M65816_phk:    // Push K (program bank register)
-					return get_sreg(cur_ea, rPB);
-				case M65816_php:    // Push processor status
-					return -1;
-				case M65816_phx:    // Push X
-					return backtrack_value(cur_ea, size, BT_X);
-				case M65816_phy:    // Push Y
-					return backtrack_value(cur_ea, size, BT_Y);
-				default:
-					return -1;
-				}
-			}
-			else if (M65_ITYPE_PULL(itype))
-			{
-				// TODO: keep track of additional displacements in the stack
-				return -1;
-			}
+			f.stop = BTS_BUDGET;
+			return;
 		}
-		break;
-	case BT_A:
-		while (true)
+		if (pm.heads.is_func_start(f.at))
+		{
+			f.stop = BTS_BOUNDARY;
+			return;
+		}
+		bt_preds(f.at, &preds);
+		if (preds.empty())
+		{
+			f.stop = BTS_BOUNDARY;
+			return;
+		}
+		if (preds.size() > 1)
+			pm.btstats.joins++;
+
+		bool straight = false;
+		for (ea_t p : preds)
 		{
-			BTWALK_PREAMBLE(cur_ea, opcode, itype);
-			uint8 opsize = from_ea - cur_ea;
-			uint8 cur_ea_acc_is_16 = is_acc_16_bits(cur_ea);
-			uint8 new_size = cur_ea_acc_is_16 ? 2 : 1;
-			switch (itype)
+			if (!pm.heads.is_code(p))
 			{
-				// All these modify A in a way we cannot
-				// easily determine its value anymore.
-				// We'll thus stop.
-			case M65816_adc:    // Add with carry
-			case M65816_and:    // AND A with memory
-			case M65816_asl:    // Shift memory or A left
-			case M65816_dec:    // Decrement
-			case M65816_eor:    // XOR A with M
-			case M65816_inc:    // Increment
-			case M65816_mvn:    // Block move next
-			case M65816_mvp:    // Block move prev
-			case M65816_ora:    // Or A with memory
-			case M65816_sbc:    // Subtract with borrow from A
-			case M65816_xba:    // Exchange bytes in A
-				return -1;
-				// For these next ones, there's hope.
-			case M65816_lsr:    // Logical shift memory or A right
-				if (opcode == 0x4a) // LSR    A
-					return -1;
+				f.stop = BTS_BOUNDARY;
+				return;
+			}
+
+			asize_t size = get_item_size(p);
+			bt_add_pages(f.pages, p, p + size);
+			walked++;
+
+			int32 val;
+			bt_query_t cur = { f.at, f.q.size, f.q.source, f.depth };
+			bt_query_t follow;
+			switch (bt_step(p, size, cur, &val, &follow))
+			{
+			case BTR_NEXT:
+				if (preds.size() == 1)
+				{
+					// Straight-line code: keep going in this frame
+					f.at = p;
+					f.depth = follow.depth;
+					straight = true;
+					break;
+				}
+				f.pending.push_back(follow);
 				break;
-			case M65816_rol:    // Rotate memory or A left
-			case M65816_ror:    // Rotate memory or A right
-				if (opcode == 0x30 || opcode == 0x70)
-					return -1;
+			case BTR_FOLLOW:
+				f.pending.push_back(follow);
+				break;
+			case BTR_VALUE:
+				bt_meet(f, BTS_VALUE, val);
+				break;
+			case BTR_UNKNOWN:
+				f.stop = BTS_UNKNOWN;
 				break;
-			case M65816_lda:    // Load A from memory
-				if (opcode == 0xa9) // LDA    imm
-					return opsize == 3 ? get_word(cur_ea + 1) : get_byte(cur_ea + 1);
-				else
-					return -1;
-			case M65816_pla:    // Pull A
-				return backtrack_value(cur_ea, new_size, BT_STACK);
-			case M65816_tdc:    // Transfer 16-bit D to A
-				return get_sreg(cur_ea, rD);
-			case M65816_tsc:    // Transfer S to A
-				return get_sreg(cur_ea, rS);
-			case M65816_txa:    // Transfer X to A
-				return backtrack_value(cur_ea, new_size, BT_X);
-			case M65816_tya:    // Transfer Y to A
-				return backtrack_value(cur_ea, new_size, BT_Y);
 			}
+			if (f.stop != BTS_FOLLOW)
+				return;
 		}
-		break;
-	case BT_X:
-		while (true)
+
+		if (!straight)
+			return;
+	}
+}
+
+// ---------------------------------------------------------------------------
+// Start on the next path of a frame that forked
+void bt_engine_t::next(bt_frame_t& f)
+{
+	const bt_query_t q = f.pending[f.next++];
+
+	int32 val;
+	const bt_pages_t* pages;
+	if (pm.btcache.lookup(q.ea, q.size, q.source, q.depth, &val, &pages))
+	{
+		for (uint32 page : *pages)
+			f.pages.add_unique(page);
+		bt_meet(f, val == -1 ? BTS_UNKNOWN : BTS_VALUE, val);
+		return;
+	}
+
+	std::map<uint64, int>::const_iterator it = open.find(key(q));
+	if (it != open.end())
+	{
+		f.cycle = qmin(f.cycle, it->second);
+		return;
+	}
+
+	push(q); // 'f' is invalid past this point
+}
+
+// ---------------------------------------------------------------------------
+bt_stop_t bt_engine_t::run(const bt_query_t& q, int32* val)
+{
+	push(q);
+	while (true)
+	{
+		int idx = int(stack.size() - 1);
+		bt_frame_t& f = stack[idx];
+		bool cyclic = false;
+		if (!f.forked)
 		{
-			BTWALK_PREAMBLE(cur_ea, opcode, itype);
-			uint8 opsize = from_ea - cur_ea;
-			uint8 cur_ea_xy_is_16 = is_xy_16_bits(cur_ea);
-			uint8 new_size = cur_ea_xy_is_16 ? 2 : 1;
-			switch (itype)
-			{
-				// All these modify X in a way we cannot
-				// easily determine its value anymore.
-				// We'll thus stop.
-			case M65816_dex:    // Decrement X
-			case M65816_inx:    // Increment X
-			case M65816_mvn:    // Block move next
-			case M65816_mvp:    // Block move prev
-				return -1;
-			case M65816_ldx:    // Load X from memory
-				if (opcode == 0xa2) // LDX    imm
-					return opsize == 3 ? get_word(cur_ea + 1) : get_byte(cur_ea + 1);
-				else
-					return -1;
-			case M65816_plx:    // Pull X
-				return backtrack_value(cur_ea, new_size, BT_STACK);
-			case M65816_tax:    // Transfer A to X
-				return backtrack_value(cur_ea, new_size, BT_A);
-			case M65816_tsx:    // Transfer S to X
-				return get_sreg(cur_ea, rS);
-			case M65816_tyx:    // Transfer Y to X
-				return backtrack_value(cur_ea, new_size, BT_Y);
-			}
+			walk(f);
+			f.forked = true;
 		}
-		break;
-	case BT_Y:
-		while (true)
+		if (f.stop == BTS_FOLLOW)
 		{
-			BTWALK_PREAMBLE(cur_ea, opcode, itype);
-			uint8 opsize = from_ea - cur_ea;
-			uint8 cur_ea_xy_is_16 = is_xy_16_bits(cur_ea);
-			uint8 new_size = cur_ea_xy_is_16 ? 2 : 1;
-			switch (itype)
+			if (f.next < f.pending.size())
 			{
-				// All these modify X in a way we cannot
-				// easily determine its value anymore.
-				// We'll thus stop.
-			case M65816_dey:    // Decrement Y
-			case M65816_iny:    // Increment Y
-			case M65816_mvn:    // Block move next
-			case M65816_mvp:    // Block move prev
-				return -1;
-			case M65816_ldy:    // Load Y from memory
-				if (opcode == 0xa0) // LDY    imm
-					return opsize == 3 ? get_word(cur_ea + 1) : get_byte(cur_ea + 1);
-				else
-					return -1;
-			case M65816_ply:    // Pull Y
-				return backtrack_value(cur_ea, new_size, BT_STACK);
-			case M65816_tay:    // Transfer A to Y
-				return backtrack_value(cur_ea, new_size, BT_A);
-			case M65816_txy:    // Transfer X to Y
-				return backtrack_value(cur_ea, new_size, BT_X);
+				next(f);
+				continue;
 			}
+			f.stop = f.have ? BTS_VALUE : BTS_UNKNOWN;
+
+			// Every path loops back to a query that is still open:
+			// that tells nothing, rather than that the value is unknown
+			cyclic = !f.have && f.cycle < idx;
 		}
-		break;
-	case BT_DP:
-		while (true)
+
+		// 'f' is answered
+		if (f.stop != BTS_VALUE)
+			f.val = -1;
+		bool depends = (f.stop == BTS_VALUE || cyclic) && f.cycle < idx;
+		if (f.stop != BTS_BUDGET && !depends)
+			pm.btcache.store(f.q.ea, f.q.size, f.q.source, f.q.depth, f.val, f.pages);
+		open.erase(key(f.q));
+
+		if (idx == 0)
 		{
-			BTWALK_PREAMBLE(cur_ea, opcode, itype);
-			switch (itype)
-			{
-				// All these modify D in a way we cannot
-				// easily determine its value anymore.
-				// We'll thus stop.
-			case M65816_pld:    // Pull D
-				return backtrack_value(cur_ea, size, BT_STACK);
-			case M65816_tcd:    // Transfer 16-bit Accumulator to Direct Page Register
-				return backtrack_value(cur_ea, size, BT_A);
-			}
+			*val = f.val;
+			return f.stop;
 		}
-		break;
-	default:
-		msg("WARNING: backtrack_value() of unsupported BT-type: %d\n", source);
-		break;
+
+		bt_frame_t& parent = stack[idx - 1];
+		for (uint32 page : f.pages)
+			parent.pages.add_unique(page);
+		if (depends)
+			parent.cycle = qmin(parent.cycle, f.cycle);
+		if (!cyclic)
+			bt_meet(parent, f.stop, f.val);
+		stack.pop_back();
 	}
+}
 
-	return -1;
+// ---------------------------------------------------------------------------
+int32 backtrack_value(ea_t from_ea, uint8 size, btsource_t source)
+{
+	m65816_t& pm = *GET_MODULE_DATA(m65816_t);
+	bt_stats_t& stats = pm.btstats;
+
+	int32 val;
+	const bt_pages_t* pages;
+	bt_stop_t stop;
+	uint32 walked = 0;
+	if (pm.btcache.lookup(from_ea, size, source, 0, &val, &pages))
+	{
+		stop = BTS_CACHED;
+	}
+	else
+	{
+		bt_engine_t engine(pm);
+		bt_query_t q = { from_ea, size, source, 0 };
+		stop = engine.run(q, &val);
+		walked = engine.walked;
+	}
+
+	stats.queries++;
+	stats.walked += walked;
+	stats.max_walk = qmax(stats.max_walk, walked);
+	stats.stops[stop]++;
+	return val;
 }
 
 // ---------------------------------------------------------------------------
 ea_t backtrack_prev_ins(ea_t from_ea, m65_itype_t itype)
 {
+	m65816_t& pm = *GET_MODULE_DATA(m65816_t);
+	uint32 budget = pm.bt_budget;
 	uint8 opcode;
 	ea_t cur_ea = from_ea;
 	uint8 candidate_itype;
-	while (true)
+	for (uint32 walked = 0; walked < budget; walked++)
 	{
-		BTWALK_PREAMBLE(cur_ea, opcode, candidate_itype);
+		BTWALK_PREAMBLE(pm.heads, cur_ea, opcode, candidate_itype);
 		if (candidate_itype == itype)
 			return cur_ea;
 	}
@@ -317,7 +681,95 @@ ea_t backtrack_prev_ins(ea_t from_ea, m65_itype_t itype)
 	return BADADDR;
 }
 
-#undef BTWALK_LOOP
-#undef BTWALK_PREAMBLE
+// ---------------------------------------------------------------------------
+void bt_add_pages(bt_pages_t& pages, ea_t start_ea, ea_t end_ea)
+{
+	for (ea_t page = start_ea >> BT_CACHE_PAGE_BITS; page <= (end_ea - 1) >> BT_CACHE_PAGE_BITS; page++)
+		if (pages.empty() || pages.back() != uint32(page))
+			pages.add_unique(uint32(page));
+}
+
+// ---------------------------------------------------------------------------
+bool bt_cache_t::lookup(ea_t from_ea, uint8 size, btsource_t source, uint8 depth, int32* val, const bt_pages_t** pages)
+{
+	key_t key = { from_ea, size, uint8(source), depth };
+	std::map<key_t, entry_t>::const_iterator it = entries.find(key);
+	if (it == entries.end())
+	{
+		misses++;
+		return false;
+	}
+	hits++;
+	*val = it->second.val;
+	*pages = &it->second.pages;
+	return true;
+}
+
+// ---------------------------------------------------------------------------
+void bt_cache_t::store(ea_t from_ea, uint8 size, btsource_t source, uint8 depth, int32 val, const bt_pages_t& pages)
+{
+	key_t key = { from_ea, size, uint8(source), depth };
+	entry_t& entry = entries[key];
+	entry.val = val;
+	entry.pages = pages;
+	for (uint32 page : pages)
+		by_page[page].push_back(key);
+}
+
+// ---------------------------------------------------------------------------
+void bt_cache_t::invalidate(ea_t start_ea, ea_t end_ea)
+{
+	if (entries.empty() || start_ea >= end_ea)
+		return;
+
+	uint32 first = uint32(start_ea >> BT_CACHE_PAGE_BITS);
+	uint32 last = uint32((end_ea - 1) >> BT_CACHE_PAGE_BITS);
+	auto drop = [this](uint32 page, const qvector<key_t>& keys)
+	{
+		for (const key_t& key : keys)
+		{
+			std::map<key_t, entry_t>::iterator it = entries.find(key);
+			if (it != entries.end() && it->second.pages.has(page))
+			{
+				entries.erase(it);
+				dropped++;
+			}
+		}
+	};
+
+	// A few pages, or more than are indexed
+	if (last - first < by_page.size())
+	{
+		for (uint32 page = first; page <= last; page++)
+		{
+			std::unordered_map<uint32, qvector<key_t> >::iterator it = by_page.find(page);
+			if (it == by_page.end())
+				continue;
+			drop(page, it->second);
+			by_page.erase(it);
+		}
+	}
+	else
+	{
+		for (std::unordered_map<uint32, qvector<key_t> >::iterator it = by_page.begin(); it != by_page.end();)
+		{
+			if (it->first < first || it->first > last)
+			{
+				++it;
+				continue;
+			}
+			drop(it->first, it->second);
+			it = by_page.erase(it);
+		}
+	}
+}
+
+// ---------------------------------------------------------------------------
+void bt_cache_t::clear()
+{
+	entries.clear();
+	by_page.clear();
+}
 
+#undef BTWALK_PREAMBLE
 
@@ -4,6 +4,8 @@
 
 #include <pro.h>
 #include <idp.hpp>
+#include <map>
+#include <unordered_map>
 
 enum btsource_t
 {
@@ -16,6 +18,35 @@ enum btsource_t
 };
 
 
+// Why a walk ended
+enum bt_stop_t
+{
+	BTS_VALUE = 0, // Found the value
+	BTS_UNKNOWN,   // Found what sets it, but that can't be determined
+	BTS_BOUNDARY,  // Reached the start of a function, or non-code
+	BTS_BUDGET,    // Looked at 'bt_budget' instructions
+	BTS_CACHED,    // Answered from bt_cache_t
+	BTS_FOLLOW,    // Internal: the value comes from another register
+	BTS_COUNT
+};
+
+// Instructions a single backtrack_value() query may look at, unless
+// set otherwise for the database (M65816_BT_BUDGET).
+#define BT_DEFAULT_BUDGET 256
+
+// Deepest a BT_STACK value is looked for under other pushes
+#define BT_MAX_STACK_DEPTH 64
+
+struct bt_stats_t
+{
+	uint32 queries = 0;
+	uint64 walked = 0;    // Instructions looked at, over all queries
+	uint32 max_walk = 0;  // Most instructions looked at by a query
+	uint32 joins = 0;     // Points where several paths met
+	uint32 stops[BTS_COUNT] = {};
+};
+
+
 /**
  * Walk instructions up, and try and determine what's the
  * (size * 8)-bits value we're looking for.
@@ -41,9 +72,23 @@ enum btsource_t
  *   backtrack_value(0xc00028, 2, BT_STACK), which will call
  *   backtrack_value(0xc00027, 2, BT_X),     which has an immediate value that we can use. Bingo.
  *
+ * Pushes and pulls in between are accounted for, with their
+ * width at that point. In:
+ *   .05:8000                 PHB
+ *   .05:8001                 PHK
+ *   .05:8002                 PLB
+ *   ...
+ *   .05:8010                 PLB
+ * the last PLB gets the bank pushed by PHB.
+ *
+ * The walk follows the code xrefs to each instruction, so it
+ * goes through branches and jumps: where several paths meet, they
+ * all have to give the same value, or it is unknown.
+ *
  * Backtracking will, of course, stop if we hit the top
  * of a function, as it doesn't make much sense to keep
- * moving up.
+ * moving up. It also stops after 'bt_budget' instructions,
+ * counting those of all the paths and registers it went through.
  *
  * from_ea : The address from which we'll be analyzing up.
  * size    : The size, in bytes, of the data we're looking for.
@@ -54,13 +99,89 @@ enum btsource_t
 int32 backtrack_value(ea_t from_ea, uint8 size, btsource_t source);
 
 
+/**
+ * Results of backtrack_value(), keyed by (from_ea, size, source), and
+ * the depth in the stack for BT_STACK.
+ *
+ * emu() backtracks from every PLB, PLD and direct page operand, and
+ * the same stretch of code gets walked over and over: a PHK/PLB
+ * repeated through a function, or a TDC/PHA/PLB that recurses through
+ * the same PLD each time. Both resolved values and -1 ("unknown") are
+ * kept, along with the pages of addresses the walk depended on, so
+ * that a change to the database only drops the entries whose walk
+ * covered the changed addresses. Entries are indexed by those pages:
+ * a walk that crossed blocks can depend on addresses far apart, and
+ * an xref being added or removed only looks at the entries of its
+ * page.
+ */
+
+// Granularity of the addresses a walk depends on
+#define BT_CACHE_PAGE_BITS 8
+
+typedef qvector<uint32> bt_pages_t;
+
+// Add the pages of [start_ea, end_ea)
+void bt_add_pages(bt_pages_t& pages, ea_t start_ea, ea_t end_ea);
+
+class bt_cache_t
+{
+public:
+	/**
+	 * returns : true, with the value in 'val' and the pages the walk
+	 *           looked at in 'pages', if the query is known.
+	 */
+	bool lookup(ea_t from_ea, uint8 size, btsource_t source, uint8 depth, int32* val, const bt_pages_t** pages);
+
+	void store(ea_t from_ea, uint8 size, btsource_t source, uint8 depth, int32 val, const bt_pages_t& pages);
+
+	/**
+	 * Drop the entries whose walk went through [start_ea, end_ea).
+	 */
+	void invalidate(ea_t start_ea, ea_t end_ea);
+	void clear();
+
+	uint32 hits = 0;
+	uint32 misses = 0;
+	uint32 dropped = 0; // Entries removed by invalidate()
+
+private:
+	struct key_t
+	{
+		ea_t ea;
+		uint8 size;
+		uint8 source;
+		uint8 depth;
+
+		bool operator<(const key_t& r) const
+		{
+			if (ea != r.ea)
+				return ea < r.ea;
+			if (size != r.size)
+				return size < r.size;
+			if (source != r.source)
+				return source < r.source;
+			return depth < r.depth;
+		}
+	};
+
+	struct entry_t
+	{
+		int32 val;
+		bt_pages_t pages; // Addresses the walk looked at
+	};
+
+	std::map<key_t, entry_t> entries;
+	std::unordered_map<uint32, qvector<key_t> > by_page; // May name dropped entries
+};
+
+
 /**
  * Walk instructions up, until an instruction with the given type
  * is found.
  *
  * Backtracking will, of course, stop if we hit the top
  * of a function, as it doesn't make much sense to keep
- * moving up.
+ * moving up, or after 'bt_budget' instructions.
  *
  * from_ea : The address from which we'll be analyzing up.
  * itype   : The instruction type.
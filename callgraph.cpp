@@ -0,0 +1,397 @@
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "m65816.hpp"
+
+// ---------------------------------------------------------------------------
+// Calls fn() on every item of every level, the items of a level spread
+// over as many threads as there are cores, and a level only started
+// once the one before it is done. The threads are started once, the
+// calling thread being one of them, and go through all the levels,
+// meeting after each. Returns the number of threads used.
+static uint32 parallel_levels(const qvector<intvec_t>& levels, const std::function<void(int)>& fn)
+{
+	size_t widest = 0;
+	for (const intvec_t& lvl : levels)
+		widest = qmax(widest, lvl.size());
+	size_t nthreads = std::min<size_t>(std::thread::hardware_concurrency(), widest);
+	if (nthreads <= 1)
+	{
+		for (const intvec_t& lvl : levels)
+			for (int item : lvl)
+				fn(item);
+		return 1;
+	}
+
+	std::atomic<size_t> next(0); // Next item of the current level
+	std::mutex mutex;
+	std::condition_variable cv;
+	size_t level = 0;            // Current level
+	size_t arrived = 0;          // Threads done with it
+	auto worker = [&]()
+	{
+		for (size_t l = 0; l < levels.size(); l++)
+		{
+			const intvec_t& lvl = levels[l];
+			for (size_t i = next++; i < lvl.size(); i = next++)
+				fn(lvl[i]);
+
+			// The last one in resets the items for the next level
+			std::unique_lock<std::mutex> lock(mutex);
+			if (++arrived == nthreads)
+			{
+				arrived = 0;
+				next = 0;
+				level++;
+				cv.notify_all();
+			}
+			else
+			{
+				cv.wait(lock, [&]() { return level > l; });
+			}
+		}
+	};
+
+	std::vector<std::thread> pool;
+	for (size_t t = 1; t < nthreads; t++)
+		pool.emplace_back(worker);
+	worker();
+	for (std::thread& t : pool)
+		t.join();
+	return uint32(nthreads);
+}
+
+// ---------------------------------------------------------------------------
+// Solves one component, whose callees outside of it are all solved.
+// Only touches the nodes of 'scc'.
+void call_graph_t::solve(qvector<node_t*>& work, const intvec_t& scc, bool recursive)
+{
+	for (int iter = 0; iter < CALLGRAPH_MAX_ITERATIONS; iter++)
+	{
+		bool changed = false;
+		for (int i : scc)
+		{
+			node_t& node = *work[i];
+			if (!node.valid)
+				continue;
+
+			for (mx_block_t& block : node.blocks)
+				for (mx_effect_t& e : block.effects)
+					if (e.kind == MXE_CALL && e.callee >= 0 && work[e.callee]->valid)
+						mx_set_call_effect(e, work[e.callee]->summary);
+
+			mx_solve(node.blocks, node.entry, node.entry_state, &node.converged);
+			if (!node.converged)
+				continue;
+
+			func_summary_t s = node.summary;
+			if (mx_summarize(node.blocks, &s) && memcmp(&s, &node.summary, sizeof(s)) != 0)
+			{
+				node.summary = s;
+				changed = true;
+			}
+		}
+		if (!changed || !recursive)
+			break;
+	}
+}
+
+// ---------------------------------------------------------------------------
+// Builds the blocks of the function at 'start_ea' again, or drops
+// it if there is no function there any more
+void call_graph_t::rebuild(ea_t start_ea)
+{
+	std::map<ea_t, node_t>::iterator it = nodes.find(start_ea);
+	if (it != nodes.end())
+	{
+		for (ea_t callee : it->second.callees)
+			callers[callee].del(start_ea);
+		nodes.erase(it);
+	}
+
+	func_t* pfn = get_func(start_ea);
+	if (pfn == nullptr || pfn->start_ea != start_ea)
+		return;
+
+	rebuilt++;
+	node_t& node = nodes[start_ea];
+	node.valid = mx_build(pfn, node.blocks, &node.entry);
+	for (const mx_block_t& block : node.blocks)
+		for (const mx_effect_t& e : block.effects)
+			if (e.kind == MXE_CALL)
+				node.callees.add_unique(e.target);
+	for (ea_t callee : node.callees)
+		callers[callee].push_back(start_ea);
+}
+
+// ---------------------------------------------------------------------------
+const qvector<mx_block_t>* call_graph_t::solved(ea_t start_ea, sel_t p, const func_summaries_t& summaries) const
+{
+	std::map<ea_t, node_t>::const_iterator it = nodes.find(start_ea);
+	if (it == nodes.end())
+		return nullptr;
+	const node_t& node = it->second;
+	if (!node.valid || !node.converged || node.summary.entry != uint16(p)
+		|| summaries.changed.count(start_ea) != 0)
+		return nullptr;
+	for (ea_t callee : node.callees)
+		if (summaries.changed.count(callee) != 0)
+			return nullptr;
+	return &node.blocks;
+}
+
+// ---------------------------------------------------------------------------
+size_t call_graph_t::run(func_summaries_t& summaries, mx_flow_t& mxflow)
+{
+	size_t nfuncs = get_func_qty();
+	if (summaries.changed.empty() && nodes.size() == nfuncs)
+		return 0;
+	runs++;
+
+	// What to build again: functions whose summary was dropped, or
+	// set to something else than what was solved here; new ones, and
+	// the callers of new and deleted ones
+	std::map<ea_t, bool> log;
+	log.swap(summaries.changed);
+	std::set<ea_t> dirty;
+	bool moved = nodes.size() != nfuncs;
+	for (const auto& c : log)
+	{
+		std::map<ea_t, node_t>::const_iterator it = nodes.find(c.first);
+		func_t* pfn = get_func(c.first);
+		if (pfn == nullptr || pfn->start_ea != c.first)
+		{
+			std::map<ea_t, eavec_t>::const_iterator cl = callers.find(c.first);
+			if (cl != callers.end())
+				dirty.insert(cl->second.begin(), cl->second.end());
+			moved = true;
+		}
+		else if (!c.second && it != nodes.end() && it->second.valid
+			&& memcmp(&summaries.get(pfn), &it->second.summary, sizeof(func_summary_t)) == 0)
+		{
+			continue;
+		}
+		dirty.insert(c.first);
+	}
+	if (moved)
+	{
+		for (const auto& node : nodes)
+		{
+			func_t* pfn = get_func(node.first);
+			if (pfn != nullptr && pfn->start_ea == node.first)
+				continue;
+			dirty.insert(node.first);
+			std::map<ea_t, eavec_t>::const_iterator cl = callers.find(node.first);
+			if (cl != callers.end())
+				dirty.insert(cl->second.begin(), cl->second.end());
+		}
+	}
+	for (size_t i = 0; moved && i < nfuncs; i++)
+	{
+		ea_t start = getn_func(i)->start_ea;
+		if (nodes.find(start) != nodes.end())
+			continue;
+		dirty.insert(start);
+		xrefblk_t xb;
+		for (bool ok = xb.first_to(start, XREF_ALL); ok; ok = xb.next_to())
+		{
+			if (!xb.iscode || (xb.type != fl_CN && xb.type != fl_CF))
+				continue;
+			func_t* caller = get_func(xb.from);
+			if (caller != nullptr)
+				dirty.insert(caller->start_ea);
+		}
+	}
+	for (ea_t ea : dirty)
+		rebuild(ea);
+
+	// Those, and everything that calls them
+	qvector<node_t*> work;
+	eavec_t starts;
+	std::map<ea_t, int> index;
+	{
+		std::set<ea_t> seen;
+		eavec_t queue(dirty.begin(), dirty.end());
+		while (!queue.empty())
+		{
+			ea_t ea = queue.back();
+			queue.pop_back();
+			if (!seen.insert(ea).second)
+				continue;
+			std::map<ea_t, node_t>::iterator it = nodes.find(ea);
+			if (it != nodes.end())
+			{
+				index[ea] = int(work.size());
+				work.push_back(&it->second);
+				starts.push_back(ea);
+			}
+			std::map<ea_t, eavec_t>::const_iterator cl = callers.find(ea);
+			if (cl != callers.end())
+				for (ea_t caller : cl->second)
+					if (seen.count(caller) == 0)
+						queue.push_back(caller);
+		}
+	}
+
+	// Calls into them are solved along; calls to the rest of the
+	// program take the summaries as they are
+	int n = int(work.size());
+	qvector<intvec_t> callees(n);
+	for (int i = 0; i < n; i++)
+	{
+		node_t& node = *work[i];
+		func_t* pfn = get_func(starts[i]);
+		sel_t p = get_pstate(starts[i]);
+		node.summary = summaries.get(pfn);
+		node.summary.entry = uint16(p);
+		node.entry_state = mx_entry_state(p);
+
+		for (mx_block_t& block : node.blocks)
+		{
+			for (mx_effect_t& e : block.effects)
+			{
+				if (e.kind != MXE_CALL)
+					continue;
+				std::map<ea_t, int>::const_iterator it = index.find(e.target);
+				if (it != index.end())
+				{
+					e.callee = it->second;
+					callees[i].add_unique(e.callee);
+					continue;
+				}
+				e.callee = -1;
+				std::map<ea_t, node_t>::const_iterator c = nodes.find(e.target);
+				if (c != nodes.end() && c->second.valid)
+					mx_set_call_effect(e, c->second.summary);
+			}
+		}
+	}
+
+	// Strongly connected components (Tarjan). They come out
+	// callees first.
+	qvector<intvec_t> components;
+	intvec_t comp(n, -1);
+	{
+		intvec_t num(n, -1);
+		intvec_t low(n, 0);
+		qvector<bool> on_stack(n, false);
+		intvec_t stack;
+		int counter = 0;
+		for (int root = 0; root < n; root++)
+		{
+			if (num[root] != -1)
+				continue;
+
+			qvector<std::pair<int, int> > walk;
+			walk.push_back(std::make_pair(root, 0));
+			num[root] = low[root] = counter++;
+			stack.push_back(root);
+			on_stack[root] = true;
+			while (!walk.empty())
+			{
+				int v = walk.back().first;
+				int next = walk.back().second;
+				if (next < int(callees[v].size()))
+				{
+					walk.back().second++;
+					int w = callees[v][next];
+					if (num[w] == -1)
+					{
+						num[w] = low[w] = counter++;
+						stack.push_back(w);
+						on_stack[w] = true;
+						walk.push_back(std::make_pair(w, 0));
+					}
+					else if (on_stack[w])
+						low[v] = qmin(low[v], num[w]);
+					continue;
+				}
+
+				if (low[v] == num[v])
+				{
+					intvec_t& scc = components.push_back();
+					int w;
+					do
+					{
+						w = stack.back();
+						stack.pop_back();
+						on_stack[w] = false;
+						comp[w] = int(components.size() - 1);
+						scc.push_back(w);
+					} while (w != v);
+				}
+				walk.pop_back();
+				if (!walk.empty())
+				{
+					int u = walk.back().first;
+					low[u] = qmin(low[u], low[v]);
+				}
+			}
+		}
+	}
+
+	// Components only depend on those of a lower level,
+	// so each level can be solved in parallel
+	qvector<intvec_t> levels;
+	{
+		intvec_t level(components.size(), 0);
+		for (size_t c = 0; c < components.size(); c++)
+		{
+			for (int i : components[c])
+				for (int callee : callees[i])
+					if (comp[callee] != int(c))
+						level[c] = qmax(level[c], level[comp[callee]] + 1);
+			if (level[c] >= int(levels.size()))
+				levels.resize(level[c] + 1);
+			levels[level[c]].push_back(int(c));
+		}
+	}
+
+	threads = parallel_levels(levels, [&](int c)
+	{
+		const intvec_t& scc = components[c];
+		// A single function that doesn't call itself needs one pass
+		bool recursive = scc.size() > 1 || callees[scc[0]].has(scc[0]);
+		solve(work, scc, recursive);
+	});
+	sccs = uint32(components.size());
+
+	// Write back, and queue the callers of whatever changed
+	qvector<bool> changed(n, false);
+	size_t nchanged = 0;
+	for (int i = 0; i < n; i++)
+	{
+		const node_t& node = *work[i];
+		func_t* pfn = get_func(starts[i]);
+		if (!node.valid || !node.converged || pfn == nullptr)
+			continue;
+		if (memcmp(&summaries.get(pfn), &node.summary, sizeof(node.summary)) != 0)
+		{
+			summaries.set(starts[i], node.summary);
+			changed[i] = true;
+			nchanged++;
+		}
+	}
+	for (int i = 0; i < n; i++)
+	{
+		for (int callee : callees[i])
+		{
+			if (changed[callee])
+			{
+				mxflow.mark(starts[i]);
+				break;
+			}
+		}
+	}
+
+	// All that was logged since is from here
+	summaries.changed.clear();
+	return nchanged;
+}
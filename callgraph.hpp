@@ -0,0 +1,75 @@
+#ifndef __CALLGRAPH_HPP__
+#define __CALLGRAPH_HPP__
+
+#include <pro.h>
+#include <map>
+#include "mxflow.hpp"
+
+// Bottom-up propagation of function summaries over the call graph.
+//
+// A caller's state after a JSR/JSL depends on the callee's summary,
+// which is only right if the callee was analyzed first. This computes
+// the summaries of all functions at once: strongly connected components
+// of the call graph are solved callees first, with a fixpoint inside
+// each component, and components that don't depend on each other are
+// solved in parallel, by threads started once per run.
+//
+// The IDA API is not thread-safe, so everything the solver needs is
+// gathered beforehand, and the results are written back afterwards,
+// both on the calling thread.
+//
+// The blocks of each function are kept between runs. A run rebuilds
+// the functions whose summary was changed or dropped by something
+// else, and those created or deleted since, and solves them again
+// along with all their callers; the rest of the program is left as
+// it was. The dataflow pass reuses the states solved here.
+
+// Fixpoint iterations allowed inside a component
+#define CALLGRAPH_MAX_ITERATIONS 8
+
+class call_graph_t
+{
+public:
+	/**
+	 * Recompute the summaries of the functions that changed since
+	 * the last run, and of their callers. The callers of functions
+	 * whose summary changed are queued for the dataflow pass.
+	 *
+	 * returns : The number of summaries that changed.
+	 */
+	size_t run(func_summaries_t& summaries, mx_flow_t& mxflow);
+
+	/**
+	 * The solved blocks of the function at 'start_ea', if they still
+	 * hold: neither the function nor its callees changed since, and it
+	 * still starts with flags 'p'.
+	 */
+	const qvector<mx_block_t>* solved(ea_t start_ea, sel_t p, const func_summaries_t& summaries) const;
+
+	void clear() { nodes.clear(); callers.clear(); }
+
+	uint32 runs = 0;    // Number of times the graph was solved
+	uint32 rebuilt = 0; // Functions whose blocks were built, over all runs
+	uint32 sccs = 0;    // Components, in the last run
+	uint32 threads = 0; // Worker threads, in the last run
+
+private:
+	struct node_t
+	{
+		qvector<mx_block_t> blocks;
+		int entry = -1;
+		mx_state_t entry_state = {};
+		eavec_t callees;
+		func_summary_t summary = {};
+		bool valid = false;
+		bool converged = false; // mx_solve() reached a fixpoint
+	};
+
+	std::map<ea_t, node_t> nodes;     // By function start
+	std::map<ea_t, eavec_t> callers;  // By callee start
+
+	void rebuild(ea_t start_ea);
+	void solve(qvector<node_t*>& work, const intvec_t& scc, bool recursive);
+};
+
+#endif
@@ -0,0 +1,41 @@
+#include "m65816.hpp"
+
+// ---------------------------------------------------------------------------
+uint64 fnv1a(uint64 h, const void* data, size_t size)
+{
+	const uchar* p = (const uchar*)data;
+	for (size_t i = 0; i < size; i++)
+	{
+		h ^= p[i];
+		h *= 0x100000001B3ULL;
+	}
+	return h;
+}
+
+// ---------------------------------------------------------------------------
+bool cart_cache_t::changed(const netnode& node)
+{
+	uint64 h = FNV1A_INIT;
+	qstring name;
+	uchar value[MAXSPECSIZE];
+	ssize_t len = node.hashfirst(&name);
+	while (len >= 0)
+	{
+		ssize_t size = node.hashval(name.c_str(), value, sizeof(value));
+		h = fnv1a(h, name.c_str(), name.length() + 1);
+		if (size > 0)
+			h = fnv1a(h, value, size_t(size));
+		qstring prev = name;
+		len = node.hashnext(&name, prev.c_str());
+	}
+
+	if (valid && h == fingerprint)
+	{
+		skips++;
+		return false;
+	}
+	fingerprint = h;
+	valid = true;
+	reloads++;
+	return true;
+}
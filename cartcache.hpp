@@ -0,0 +1,48 @@
+#ifndef __CARTCACHE_HPP__
+#define __CARTCACHE_HPP__
+
+#include <pro.h>
+#include <netnode.hpp>
+
+// Cartridge and mapper state, kept across undo.
+//
+// Every undo step ends with ev_ending_undo, which reloads the module's
+// state from the database. Reading the cartridge back, setting up the
+// mapper, and rebuilding the translation table and the I/O ports are
+// the bulk of that, and what they are loaded from (the hash of the
+// helper netnode) seldom changes with an undo. The hash is
+// fingerprinted, and the reload is skipped when the fingerprint is the
+// one it was last loaded from.
+
+/**
+ * FNV-1a hash of 'size' bytes at 'data', continuing from 'h'
+ * (FNV1A_INIT to start one).
+ */
+#define FNV1A_INIT 0xCBF29CE484222325ULL
+uint64 fnv1a(uint64 h, const void* data, size_t size);
+
+class cart_cache_t
+{
+public:
+	/**
+	 * Fingerprint the hash of 'node', and remember it.
+	 *
+	 * returns : true if it changed since the last call, or if
+	 *           there was none since clear().
+	 */
+	bool changed(const netnode& node);
+
+	void clear() { valid = false; }
+
+	uint32 reloads = 0;      // Cartridge reloads
+	uint32 skips = 0;        // Reloads skipped as unchanged
+	uint32 undos = 0;        // Undo steps
+	uint64 undo_nsec = 0;    // Time spent reloading after them
+	uint64 undo_max_nsec = 0;
+
+private:
+	uint64 fingerprint = 0;
+	bool valid = false;
+};
+
+#endif
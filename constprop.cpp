@@ -0,0 +1,433 @@
+#include <iterator>
+#include <utility>
+
+#include "m65816.hpp"
+
+// ---------------------------------------------------------------------------
+cp_state_t cp_entry_state(cp_value_t d, cp_value_t db, cp_value_t pb)
+{
+	cp_state_t s;
+	s.al = s.ah = s.x = s.y = CP_UNKNOWN;
+	s.d = d;
+	s.db = db;
+	s.pb = pb;
+	s.depth = 0;
+	return s;
+}
+
+// ---------------------------------------------------------------------------
+static void cp_push(cp_state_t& s, cp_value_t byte)
+{
+	// Drop the oldest byte: it's as if it had been pushed
+	// before the block
+	if (s.depth == CP_MAX_STACK)
+	{
+		memmove(&s.stack[0], &s.stack[1], (CP_MAX_STACK - 1) * sizeof(s.stack[0]));
+		s.depth--;
+	}
+	s.stack[s.depth++] = byte;
+}
+
+// Pushes the high byte first, like the CPU does
+static void cp_push_value(cp_state_t& s, cp_value_t v, int size)
+{
+	for (int i = size - 1; i >= 0; i--)
+		cp_push(s, v == CP_UNKNOWN ? CP_UNKNOWN : (v >> (8 * i)) & 0xFF);
+}
+
+static cp_value_t cp_pull_value(cp_state_t& s, int size)
+{
+	cp_value_t v = 0;
+	for (int i = 0; i < size; i++)
+	{
+		cp_value_t byte = s.depth == 0 ? CP_UNKNOWN : s.stack[--s.depth];
+		if (byte == CP_UNKNOWN || v == CP_UNKNOWN)
+			v = CP_UNKNOWN;
+		else
+			v |= byte << (8 * i);
+	}
+	return v;
+}
+
+// ---------------------------------------------------------------------------
+// A, as wide as the accumulator
+static cp_value_t cp_get_a(const cp_state_t& s, bool acc16)
+{
+	if (!acc16)
+		return s.al;
+	if (s.al == CP_UNKNOWN || s.ah == CP_UNKNOWN)
+		return CP_UNKNOWN;
+	return (s.ah << 8) | s.al;
+}
+
+// B is left alone when the accumulator is 8 bits
+static void cp_set_a(cp_state_t& s, cp_value_t v, bool acc16)
+{
+	s.al = v == CP_UNKNOWN ? CP_UNKNOWN : v & 0xFF;
+	if (acc16)
+		s.ah = v == CP_UNKNOWN ? CP_UNKNOWN : (v >> 8) & 0xFF;
+}
+
+// The high byte of the index registers is zero when they are 8 bits
+static cp_value_t cp_index(cp_value_t v, bool xy16)
+{
+	return v == CP_UNKNOWN ? CP_UNKNOWN : v & (xy16 ? 0xFFFF : 0xFF);
+}
+
+static cp_value_t cp_add(cp_value_t v, int delta, bool wide)
+{
+	return v == CP_UNKNOWN ? CP_UNKNOWN : (v + delta) & (wide ? 0xFFFF : 0xFF);
+}
+
+// ---------------------------------------------------------------------------
+void cp_step(cp_state_t& s, const m65_decoded_t& insn, const func_summary_t* callee)
+{
+	bool acc16 = mode_acc_16(insn.mode);
+	bool xy16 = mode_xy_16(insn.mode);
+	int asize = acc16 ? 2 : 1;
+	int xsize = xy16 ? 2 : 1;
+	bool imm = insn.addr == IMM;
+	bool acc = insn.addr == ACC;
+
+	switch (insn.itype)
+	{
+	case M65816_lda:
+		cp_set_a(s, imm ? cp_value_t(insn.operand) : CP_UNKNOWN, acc16);
+		break;
+	case M65816_ldx:
+		s.x = imm ? cp_index(insn.operand, xy16) : CP_UNKNOWN;
+		break;
+	case M65816_ldy:
+		s.y = imm ? cp_index(insn.operand, xy16) : CP_UNKNOWN;
+		break;
+
+	case M65816_and:
+	case M65816_ora:
+	case M65816_eor:
+	{
+		cp_value_t a = cp_get_a(s, acc16);
+		if (!imm || a == CP_UNKNOWN)
+			cp_set_a(s, CP_UNKNOWN, acc16);
+		else if (insn.itype == M65816_and)
+			cp_set_a(s, a & insn.operand, acc16);
+		else if (insn.itype == M65816_ora)
+			cp_set_a(s, a | insn.operand, acc16);
+		else
+			cp_set_a(s, a ^ insn.operand, acc16);
+	}
+	break;
+
+	// Depend on the carry
+	case M65816_adc:
+	case M65816_sbc:
+		cp_set_a(s, CP_UNKNOWN, acc16);
+		break;
+	case M65816_rol:
+	case M65816_ror:
+		if (acc)
+			cp_set_a(s, CP_UNKNOWN, acc16);
+		break;
+
+	case M65816_asl:
+	case M65816_lsr:
+	case M65816_inc:
+	case M65816_dec:
+		if (acc)
+		{
+			cp_value_t a = cp_get_a(s, acc16);
+			if (a == CP_UNKNOWN)
+				cp_set_a(s, CP_UNKNOWN, acc16);
+			else if (insn.itype == M65816_asl)
+				cp_set_a(s, a << 1, acc16);
+			else if (insn.itype == M65816_lsr)
+				cp_set_a(s, a >> 1, acc16);
+			else
+				cp_set_a(s, cp_add(a, insn.itype == M65816_inc ? 1 : -1, acc16), acc16);
+		}
+		break;
+
+	case M65816_inx: s.x = cp_add(s.x, 1, xy16); break;
+	case M65816_dex: s.x = cp_add(s.x, -1, xy16); break;
+	case M65816_iny: s.y = cp_add(s.y, 1, xy16); break;
+	case M65816_dey: s.y = cp_add(s.y, -1, xy16); break;
+
+	// Transfers are as wide as the destination. A 16-bit
+	// index register gets all of C, whatever M is.
+	case M65816_tax: s.x = cp_index(cp_get_a(s, xy16), xy16); break;
+	case M65816_tay: s.y = cp_index(cp_get_a(s, xy16), xy16); break;
+	case M65816_txa: cp_set_a(s, s.x, acc16); break;
+	case M65816_tya: cp_set_a(s, s.y, acc16); break;
+	case M65816_txy: s.y = cp_index(s.x, xy16); break;
+	case M65816_tyx: s.x = cp_index(s.y, xy16); break;
+	case M65816_tcd: s.d = cp_get_a(s, true); break;
+	case M65816_tdc: cp_set_a(s, s.d, true); break;
+	case M65816_tsc: cp_set_a(s, CP_UNKNOWN, true); break;
+	case M65816_tsx: s.x = CP_UNKNOWN; break;
+	case M65816_xba: std::swap(s.al, s.ah); break;
+
+	// What was pushed before is somewhere else now
+	case M65816_tcs:
+	case M65816_txs:
+		s.depth = 0;
+		break;
+
+	case M65816_sep:
+		if ((insn.operand & 0x10) != 0)
+		{
+			s.x = cp_index(s.x, false);
+			s.y = cp_index(s.y, false);
+		}
+		break;
+
+	case M65816_pha: cp_push_value(s, cp_get_a(s, acc16), asize); break;
+	case M65816_phx: cp_push_value(s, s.x, xsize); break;
+	case M65816_phy: cp_push_value(s, s.y, xsize); break;
+	case M65816_phb: cp_push_value(s, s.db, 1); break;
+	case M65816_phd: cp_push_value(s, s.d, 2); break;
+	case M65816_phk: cp_push_value(s, s.pb, 1); break;
+	case M65816_php: cp_push_value(s, CP_UNKNOWN, 1); break;
+	case M65816_pea: cp_push_value(s, insn.operand & 0xFFFF, 2); break;
+	case M65816_pei: cp_push_value(s, CP_UNKNOWN, 2); break;
+	case M65816_per:
+		cp_push_value(s, (insn.ea + insn.size + int16(insn.operand)) & 0xFFFF, 2);
+		break;
+
+	case M65816_pla: cp_set_a(s, cp_pull_value(s, asize), acc16); break;
+	case M65816_plx: s.x = cp_pull_value(s, xsize); break;
+	case M65816_ply: s.y = cp_pull_value(s, xsize); break;
+	case M65816_plb: s.db = cp_pull_value(s, 1); break;
+	case M65816_pld: s.d = cp_pull_value(s, 2); break;
+	case M65816_plp: cp_pull_value(s, 1); break;
+
+	// A ends up as $FFFF, DB as the destination bank
+	case M65816_mvn:
+	case M65816_mvp:
+		s.al = s.ah = 0xFF;
+		s.x = s.y = CP_UNKNOWN;
+		s.db = insn.operand & 0xFF;
+		break;
+
+	case M65816_jsr:
+	case M65816_jsl:
+		s.al = s.ah = s.x = s.y = CP_UNKNOWN;
+		if (callee == nullptr)
+		{
+			s.d = s.db = CP_UNKNOWN;
+			break;
+		}
+		if (callee->db_kind == MXR_CONST)
+			s.db = callee->exit_db & 0xFF;
+		else if (callee->db_kind != MXR_ENTRY)
+			s.db = CP_UNKNOWN;
+		if (callee->dp_kind == MXR_CONST)
+			s.d = callee->exit_dp;
+		else if (callee->dp_kind != MXR_ENTRY)
+			s.d = CP_UNKNOWN;
+		break;
+	}
+}
+
+// ---------------------------------------------------------------------------
+// Where the state coming from the previous instruction isn't the only
+// one: function starts, branch targets, and code nothing flows into.
+static bool cp_is_block_start(ea_t ea)
+{
+	if (get_head_index().is_func_start(ea))
+		return true;
+	bool flow = false;
+	xrefblk_t xb;
+	for (bool ok = xb.first_to(ea, XREF_ALL); ok; ok = xb.next_to())
+	{
+		if (!xb.iscode)
+			continue;
+		if (xb.type != fl_F)
+			return true;
+		flow = true;
+	}
+	return !flow;
+}
+
+// ---------------------------------------------------------------------------
+static cp_value_t cp_from_sel(sel_t v)
+{
+	return v == BADSEL ? CP_UNKNOWN : cp_value_t(v & 0xFFFF);
+}
+
+// ---------------------------------------------------------------------------
+// D and DB set by the user from 'ea' on, inside a block, take over
+// from what was propagated
+static void cp_user_ranges(cp_state_t& s, ea_t ea)
+{
+	sreg_range_t r;
+	if (get_sreg_range(&r, ea, rD) && r.start_ea == ea && r.tag == SR_user)
+		s.d = cp_from_sel(r.val);
+	if (get_sreg_range(&r, ea, rB) && r.start_ea == ea && r.tag == SR_user)
+		s.db = r.val == BADSEL ? CP_UNKNOWN : cp_value_t(r.val & 0xFF);
+}
+
+// ---------------------------------------------------------------------------
+void const_facts_t::erase(std::map<ea_t, block_t>::iterator it)
+{
+	facts.erase(facts.lower_bound(it->first), facts.lower_bound(it->second.end_ea));
+	blocks.erase(it);
+}
+
+// ---------------------------------------------------------------------------
+void const_facts_t::build(ea_t ea)
+{
+	head_index_t& heads = get_head_index();
+
+	// Back to the start of the block, or as far as a block may go
+	// while still reaching 'ea'
+	ea_t start = ea;
+	for (int n = 0; n < CP_MAX_BLOCK - 1 && !cp_is_block_start(start); n++)
+	{
+		ea_t prev = heads.prev(start, 0);
+		if (prev == BADADDR || !heads.is_code(prev))
+			break;
+		start = prev;
+	}
+
+	builds++;
+	cpu_mode_t m = get_cpu_mode(start);
+	cp_state_t s = cp_entry_state(cp_from_sel(m.dp), cp_from_sel(m.db), cp_from_sel(m.pb));
+	block_t block = { start, GET_MODULE_DATA(m65816_t)->summaries.gen, false };
+	qvector<std::pair<ea_t, fact_t> > run;
+
+	ea_t cur = start;
+	for (int n = 0; n < CP_MAX_BLOCK; n++)
+	{
+		uint8 bytes[M65_MAX_INSN_SIZE];
+		ssize_t len = get_bytes(bytes, sizeof(bytes), cur);
+		m65_decoded_t insn;
+		if (len <= 0 || decode_bytes(bytes, size_t(len), uint32(cur), get_cpu_mode(cur).mode, &insn) == 0)
+			break;
+
+		const func_summary_t* callee = nullptr;
+		if (insn.itype == M65816_jsr || insn.itype == M65816_jsl)
+		{
+			block.calls = true;
+			func_t* pfn = get_func(get_first_fcref_from(cur));
+			if (pfn != nullptr)
+				callee = &get_func_summary(pfn);
+		}
+
+		if (cur != start)
+			cp_user_ranges(s, cur);
+
+		fact_t f;
+		f.d_in = s.d;
+		cp_step(s, insn, callee);
+		f.d_out = s.d;
+		f.db_out = s.db;
+		run.push_back(std::make_pair(cur, f));
+
+		// COP arguments are part of the item
+		ea_t next = heads.next(cur, BADADDR);
+		block.end_ea = next == BADADDR ? cur + insn.size : next;
+		if (next == BADADDR || !heads.is_code(next) || cp_is_block_start(next))
+			break;
+		cur = next;
+	}
+	if (run.empty())
+		return;
+
+	invalidate(start, block.end_ea);
+	blocks[start] = block;
+	for (const auto& f : run)
+		facts[f.first] = f.second;
+}
+
+// ---------------------------------------------------------------------------
+const const_facts_t::fact_t* const_facts_t::get(ea_t ea)
+{
+	lookups++;
+	for (int attempt = 0; attempt < 2; attempt++)
+	{
+		std::map<ea_t, block_t>::iterator b = blocks.upper_bound(ea);
+		if (b != blocks.begin())
+		{
+			--b;
+			if (ea < b->second.end_ea)
+			{
+				// The callees' summaries it used have changed
+				if (b->second.calls && b->second.gen != GET_MODULE_DATA(m65816_t)->summaries.gen)
+					erase(b);
+				else
+				{
+					std::map<ea_t, fact_t>::const_iterator f = facts.find(ea);
+					return f == facts.end() ? nullptr : &f->second;
+				}
+			}
+		}
+		if (attempt == 0)
+			build(ea);
+	}
+	return nullptr;
+}
+
+// ---------------------------------------------------------------------------
+cp_value_t const_facts_t::d_before(ea_t ea)
+{
+	const fact_t* f = get(ea);
+	return f == nullptr ? CP_UNKNOWN : f->d_in;
+}
+
+cp_value_t const_facts_t::d_after(ea_t ea)
+{
+	const fact_t* f = get(ea);
+	return f == nullptr ? CP_UNKNOWN : f->d_out;
+}
+
+cp_value_t const_facts_t::db_after(ea_t ea)
+{
+	const fact_t* f = get(ea);
+	return f == nullptr ? CP_UNKNOWN : f->db_out;
+}
+
+// ---------------------------------------------------------------------------
+void const_facts_t::invalidate(ea_t start_ea, ea_t end_ea)
+{
+	std::map<ea_t, block_t>::iterator it = blocks.upper_bound(start_ea);
+	if (it != blocks.begin())
+	{
+		std::map<ea_t, block_t>::iterator prev = std::prev(it);
+		if (prev->second.end_ea > start_ea)
+			it = prev;
+	}
+	while (it != blocks.end() && it->first < end_ea)
+	{
+		std::map<ea_t, block_t>::iterator next = std::next(it);
+		erase(it);
+		it = next;
+	}
+}
+
+// ---------------------------------------------------------------------------
+void const_facts_t::sreg_changed(ea_t start_ea, ea_t end_ea, int rg)
+{
+	if (rg == rP || rg == rPB)
+	{
+		invalidate(start_ea, end_ea);
+		return;
+	}
+	if (rg != rB && rg != rD && rg != rDs)
+		return;
+
+	// The block the range starts in, and those that start in it
+	invalidate(start_ea, start_ea + 1);
+	std::map<ea_t, block_t>::iterator it = blocks.lower_bound(start_ea);
+	while (it != blocks.end() && it->first < end_ea)
+	{
+		std::map<ea_t, block_t>::iterator next = std::next(it);
+		erase(it);
+		it = next;
+	}
+}
+
+// ---------------------------------------------------------------------------
+void const_facts_t::clear()
+{
+	blocks.clear();
+	facts.clear();
+}
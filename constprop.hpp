@@ -0,0 +1,110 @@
+#ifndef __CONSTPROP_HPP__
+#define __CONSTPROP_HPP__
+
+#include <pro.h>
+#include <map>
+#include "decode.hpp"
+#include "summary.hpp"
+
+// Forward constant propagation over straight-line code.
+//
+// Backtracking recovers a register value by walking up from where it's
+// needed, and each PLB, PLD and direct page operand starts a new walk.
+// Here, a block is run through once from its start, tracking A (one
+// byte at a time, for XBA), X, Y, D, DB and the bytes pushed in the
+// block, and what's known of D and DB is kept for each instruction.
+// D and DB ranges set by the user inside a block override what was
+// propagated.
+//
+// cp_step() only works on the data it is given; const_facts_t finds
+// the blocks in the database and keeps the results.
+
+
+// A register or stack byte: known if not CP_UNKNOWN
+typedef int32 cp_value_t;
+#define CP_UNKNOWN (-1)
+
+// Bytes of the stack tracked per block; older ones are dropped
+#define CP_MAX_STACK 32
+
+// Instructions run through per block
+#define CP_MAX_BLOCK 1024
+
+struct cp_state_t
+{
+	cp_value_t al;   // A, low byte
+	cp_value_t ah;   // A, high byte (B)
+	cp_value_t x;
+	cp_value_t y;
+	cp_value_t d;    // Direct page
+	cp_value_t db;   // Data bank
+	cp_value_t pb;   // Program bank
+	int depth;       // Bytes pushed in the block, still on the stack
+	cp_value_t stack[CP_MAX_STACK]; // Top last
+};
+
+/**
+ * State at the start of a block: D, DB and PB as given, the rest unknown.
+ */
+cp_state_t cp_entry_state(cp_value_t d, cp_value_t db, cp_value_t pb);
+
+/**
+ * Run one instruction.
+ *
+ * callee : For JSR/JSL, the summary of the function called, if known.
+ */
+void cp_step(cp_state_t& s, const m65_decoded_t& insn, const func_summary_t* callee);
+
+
+class const_facts_t
+{
+public:
+	/**
+	 * D when the instruction at 'ea' runs, and D and DB after it.
+	 * CP_UNKNOWN if they can't be determined within its block.
+	 */
+	cp_value_t d_before(ea_t ea);
+	cp_value_t d_after(ea_t ea);
+	cp_value_t db_after(ea_t ea);
+
+	/**
+	 * Drop the blocks that overlap [start_ea, end_ea).
+	 */
+	void invalidate(ea_t start_ea, ea_t end_ea);
+
+	/**
+	 * To be called from the sgr_changed event. Blocks depend on DB
+	 * and D where they start and where the user set them, and on the
+	 * flags and PB throughout.
+	 */
+	void sreg_changed(ea_t start_ea, ea_t end_ea, int rg);
+
+	void clear();
+
+	uint32 lookups = 0;
+	uint32 builds = 0; // Blocks run through
+
+private:
+	struct fact_t
+	{
+		cp_value_t d_in;
+		cp_value_t d_out;
+		cp_value_t db_out;
+	};
+
+	struct block_t
+	{
+		ea_t end_ea;
+		uint32 gen;  // func_summaries_t::gen, if the block has calls
+		bool calls;
+	};
+
+	std::map<ea_t, block_t> blocks; // By start
+	std::map<ea_t, fact_t> facts;
+
+	const fact_t* get(ea_t ea);
+	void build(ea_t ea);
+	void erase(std::map<ea_t, block_t>::iterator it);
+};
+
+#endif
@@ -0,0 +1,98 @@
+#ifndef __COPDESC_HPP__
+#define __COPDESC_HPP__
+
+#include <stdint.h>
+#include "ida/gaia_cop.hpp"
+
+// COP argument layouts, compiled from cop_lst.
+//
+// Each cop_def describes its arguments as a string ("bwc": a byte, a
+// word and a code address). Rather than going through that string each
+// time a COP is decoded, it is turned at compile time into a fixed
+// list of slots, giving where each argument is, how wide it is, and
+// what it is.
+
+// Arguments a COP can have: one operand each, after the signature
+#define COP_MAX_SLOTS 7
+
+struct cop_slot_t
+{
+	uint8_t offb;  // Offset of the argument in the instruction
+	uint8_t width; // 1, 2 or 3 bytes
+	bool addr;     // An address ('o', 'c', 'O', 'C') rather than a value
+	bool code;     // A code address ('c', 'C')
+};
+
+struct cop_desc_t
+{
+	bool valid;    // There is a cop_def for this signature
+	bool noret;
+	uint8_t nslots;
+	uint8_t length; // Bytes of arguments, after the signature
+	cop_slot_t slots[COP_MAX_SLOTS];
+};
+
+struct cop_desc_table_t
+{
+	cop_desc_t descs[0x100];
+
+	// 'length' of each signature, as decode_bytes() takes them
+	uint8_t sizes[0x100];
+};
+
+// ---------------------------------------------------------------------------
+static constexpr cop_desc_t make_cop_desc(const cop_def& def, int sig)
+{
+	cop_desc_t desc = {};
+	desc.valid = def.op == sig;
+	desc.noret = def.noret;
+	if (!desc.valid)
+		return desc;
+
+	// Arguments start after the opcode and the signature
+	uint8_t off = 2;
+	for (int i = 0; i < COP_MAX_SLOTS && def.mem[i] != 0; i++)
+	{
+		cop_slot_t slot = {};
+		switch (def.mem[i])
+		{
+		case 'b': slot.width = 1; break;
+		case 'w': slot.width = 2; break;
+		case 'o': slot.width = 2; slot.addr = true; break;
+		case 'c': slot.width = 2; slot.addr = true; slot.code = true; break;
+		case 'W': slot.width = 3; break;
+		case 'O': slot.width = 3; slot.addr = true; break;
+		case 'C': slot.width = 3; slot.addr = true; slot.code = true; break;
+		}
+
+		// The rest of the string is ignored past an unknown letter
+		if (slot.width == 0)
+			break;
+		slot.offb = off;
+		off += slot.width;
+		desc.slots[desc.nslots++] = slot;
+	}
+	desc.length = uint8_t(off - 2);
+	return desc;
+}
+
+// ---------------------------------------------------------------------------
+static constexpr cop_desc_table_t make_cop_desc_table()
+{
+	cop_desc_table_t table = {};
+	for (int sig = 0; sig < 0x100; sig++)
+	{
+		table.descs[sig] = make_cop_desc(cop_lst[sig], sig);
+		table.sizes[sig] = table.descs[sig].length;
+	}
+	return table;
+}
+
+static constexpr cop_desc_table_t cop_descs = make_cop_desc_table();
+
+static_assert(cop_descs.descs[0x26].length == 8 && cop_descs.descs[0x26].nslots == 5,
+	"COP $26 takes a byte, two words, a byte and a word");
+static_assert(cop_descs.descs[0x19].slots[1].width == 3 && cop_descs.descs[0x19].slots[1].offb == 3,
+	"The long address of COP $19 follows its byte argument");
+
+#endif
@@ -0,0 +1,171 @@
+#include "m65816.hpp"
+
+// ---------------------------------------------------------------------------
+cop_dialects_t::cop_dialects_t(netnode& node) : node(node), cur(COP_DIALECT_BUILTIN)
+{
+	memcpy(defs, cop_lst, sizeof(defs));
+	memcpy(descs, cop_descs.descs, sizeof(descs));
+	memcpy(arg_sizes, cop_descs.sizes, sizeof(arg_sizes));
+}
+
+// ---------------------------------------------------------------------------
+void cop_dialects_t::compile()
+{
+	for (int sig = 0; sig < 0x100; sig++)
+	{
+		descs[sig] = make_cop_desc(defs[sig], sig);
+		arg_sizes[sig] = descs[sig].length;
+	}
+}
+
+// ---------------------------------------------------------------------------
+// Lines of COP_DIALECT_FILE, past comments and blanks. Returns false
+// at the end of the file.
+static bool next_line(FILE* fp, char* buf, size_t bufsize, int* lineno)
+{
+	while (qfgets(buf, bufsize, fp) != nullptr)
+	{
+		++*lineno;
+		char* p = skip_spaces(buf);
+		size_t len = strlen(p);
+		while (len > 0 && qisspace(p[len - 1]))
+			p[--len] = '\0';
+		if (len == 0 || p[0] == ';')
+			continue;
+		memmove(buf, p, len + 1);
+		return true;
+	}
+	return false;
+}
+
+// ---------------------------------------------------------------------------
+bool cop_dialects_t::read_file(const char* name, cop_def* out, qstring* errbuf)
+{
+	char path[QMAXPATH];
+	FILE* fp = nullptr;
+	if (getsysfile(path, sizeof(path), COP_DIALECT_FILE, CFG_SUBDIR) != nullptr)
+		fp = qfopen(path, "r");
+	if (fp == nullptr)
+	{
+		errbuf->sprnt("%s not found", COP_DIALECT_FILE);
+		return false;
+	}
+
+	// Signatures not listed match no cop_def
+	memset(out, 0, sizeof(cop_def) * 0x100);
+	for (int sig = 0; sig < 0x100; sig++)
+		out[sig].op = -1;
+	bool found = false;
+	bool ok = true;
+	int lineno = 0;
+	char line[MAXSTR];
+	while (ok && next_line(fp, line, sizeof(line), &lineno))
+	{
+		if (line[0] == '.')
+		{
+			if (found)
+				break;
+			found = streq(line + 1, name);
+			continue;
+		}
+		if (!found)
+			continue;
+
+		unsigned int sig;
+		char args[16];
+		char flag[16] = "";
+		if (qsscanf(line, "%x %15s %15s", &sig, args, flag) < 2 || sig > 0xFF)
+		{
+			errbuf->sprnt("%s, line %d: bad COP definition", COP_DIALECT_FILE, lineno);
+			ok = false;
+			break;
+		}
+
+		cop_def& def = out[sig];
+		def.op = short(sig);
+		def.noret = streq(flag, "noret");
+		if (!streq(args, "-"))
+		{
+			if (strlen(args) >= sizeof(def.mem))
+			{
+				errbuf->sprnt("%s, line %d: too many arguments", COP_DIALECT_FILE, lineno);
+				ok = false;
+				break;
+			}
+			qstrncpy(def.mem, args, sizeof(def.mem));
+		}
+		def.size = char(make_cop_desc(def, sig).length);
+	}
+	qfclose(fp);
+
+	if (ok && !found)
+	{
+		errbuf->sprnt("No COP dialect named '%s' in %s", name, COP_DIALECT_FILE);
+		ok = false;
+	}
+	return ok;
+}
+
+// ---------------------------------------------------------------------------
+bool cop_dialects_t::select(const char* name, bool store, qstring* errbuf)
+{
+	cop_def parsed[0x100];
+	if (streq(name, COP_DIALECT_BUILTIN))
+		memcpy(parsed, cop_lst, sizeof(parsed));
+	else if (!read_file(name, parsed, errbuf))
+		return false;
+
+	memcpy(defs, parsed, sizeof(defs));
+	cur = name;
+	compile();
+	if (store)
+	{
+		node.hashset("cop_dialect", cur.c_str(), cur.length() + 1);
+		node.setblob(defs, sizeof(defs), 0, COP_DIALECT_TAG);
+	}
+	return true;
+}
+
+// ---------------------------------------------------------------------------
+void cop_dialects_t::load()
+{
+	bytevec_t blob;
+	qstring name;
+	if (node.hashstr(&name, "cop_dialect") > 0
+		&& node.getblob(&blob, 0, COP_DIALECT_TAG) == sizeof(defs))
+	{
+		memcpy(defs, &blob[0], sizeof(defs));
+		cur = name;
+	}
+	else
+	{
+		memcpy(defs, cop_lst, sizeof(defs));
+		cur = COP_DIALECT_BUILTIN;
+	}
+	compile();
+}
+
+// ---------------------------------------------------------------------------
+qstring cop_dialects_t::default_name()
+{
+	qstring name(COP_DIALECT_BUILTIN);
+	char path[QMAXPATH];
+	FILE* fp = nullptr;
+	if (getsysfile(path, sizeof(path), COP_DIALECT_FILE, CFG_SUBDIR) != nullptr)
+		fp = qfopen(path, "r");
+	if (fp == nullptr)
+		return name;
+
+	int lineno = 0;
+	char line[MAXSTR];
+	while (next_line(fp, line, sizeof(line), &lineno))
+	{
+		if (strneq(line, ".default", 8) && qisspace(line[8]))
+		{
+			name = skip_spaces(line + 8);
+			break;
+		}
+	}
+	qfclose(fp);
+	return name;
+}
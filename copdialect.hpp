@@ -0,0 +1,64 @@
+#ifndef __COPDIALECT_HPP__
+#define __COPDIALECT_HPP__
+
+#include <pro.h>
+#include <netnode.hpp>
+#include "copdesc.hpp"
+
+// COP dialect of the database.
+//
+// cop_lst (the "gaia" dialect) is built into the module. Other games
+// of the same family use the same engine with different COP commands;
+// those are described in m65816_cop.cfg, so that they can be analyzed
+// without rebuilding anything. The dialect chosen is compiled into the
+// same 256-entry table as the built-in one, and kept in the helper
+// netnode along with its name, so that a database decodes the same
+// way whatever happens to the file afterwards.
+
+#define COP_DIALECT_FILE "m65816_cop.cfg"
+#define COP_DIALECT_BUILTIN "gaia"
+
+// Netnode tag of the cop_def's of the dialect
+#define COP_DIALECT_TAG 'O'
+
+class cop_dialects_t
+{
+public:
+	cop_dialects_t(netnode& node);
+
+	const cop_desc_t& get(uint8 sig) const { return descs[sig]; }
+
+	// Argument lengths, as decode_bytes() takes them
+	const uint8* sizes() const { return arg_sizes; }
+
+	const char* name() const { return cur.c_str(); }
+
+	/**
+	 * Switch to the dialect 'name', from COP_DIALECT_FILE or built in.
+	 * If 'store' is set, it is saved to the database.
+	 */
+	bool select(const char* name, bool store, qstring* errbuf);
+
+	/**
+	 * Make the dialect of the database current, or the built-in
+	 * one if it has none.
+	 */
+	void load();
+
+	/**
+	 * The dialect COP_DIALECT_FILE gives for new databases.
+	 */
+	static qstring default_name();
+
+private:
+	netnode& node;
+	qstring cur;
+	cop_def defs[0x100];
+	cop_desc_t descs[0x100];
+	uint8 arg_sizes[0x100];
+
+	void compile();
+	static bool read_file(const char* name, cop_def* defs, qstring* errbuf);
+};
+
+#endif
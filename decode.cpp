@@ -0,0 +1,717 @@
+#include "decode.hpp"
+
+#define DI(itype, len, addr_mode, cpus) { (itype), (addr_mode), (cpus) },
+#define DV(itype, len, addr_mode, cpus, flags) { (itype), (addr_mode), (cpus), (flags) },
+
+static constexpr struct opcode_info_t opinfos[] =
+{
+	// 0x00
+	DI(M65816_brk, 2, STACK_INT,              M6X)
+	DI(M65816_ora, 2, DP_IX_INDIR,            M6X)
+	DI(M65816_cop, 2, STACK_INT,              M65816)
+	DI(M65816_ora, 2, STACK_REL,              M65816)
+	DI(M65816_tsb, 2, DP,                     M65C02 | M65816)
+	DI(M65816_ora, 2, DP,                     M6X)
+	DI(M65816_asl, 2, DP,                     M6X)
+	DI(M65816_ora, 2, DP_INDIR_LONG,          M6X)
+
+	// 0x08
+	DI(M65816_php, 1, STACK_PUSH,             M6X)
+	DV(M65816_ora, 2, IMM,                    M6X, ACC16_INCBC)
+	DI(M65816_asl, 1, ACC,                    M6X)
+	DI(M65816_phd, 1, STACK_PUSH,             M65816)
+	DI(M65816_tsb, 3, ABS,                    M65C02 | M65816)
+	DI(M65816_ora, 3, ABS,                    M6X)
+	DI(M65816_asl, 3, ABS,                    M6X)
+	DI(M65816_ora, 4, ABS_LONG,               M65816)
+
+	// 0x10
+	DI(M65816_bpl, 2, PC_REL,                 M6X)
+	DI(M65816_ora, 2, DP_INDIR_IY,            M6X)
+	DI(M65816_ora, 2, DP_INDIR,               M65C02 | M65816)
+	DI(M65816_ora, 2, STACK_REL_INDIR_IY,     M65816)
+	DI(M65816_trb, 2, DP,                     M65C02 | M65816)
+	DI(M65816_ora, 2, DP_IX,                  M6X)
+	DI(M65816_asl, 2, DP_IX,                  M6X)
+	DI(M65816_ora, 2, DP_INDIR_LONG_IY,       M65816)
+
+	// 0x18
+	DI(M65816_clc, 1, IMPLIED,                M6X)
+	DI(M65816_ora, 3, ABS_IY,                 M6X)
+	DI(M65816_inc, 1, ACC,                    M65C02 | M65816)
+	DI(M65816_tcs, 1, IMPLIED,                M65816)
+	DI(M65816_trb, 3, ABS,                    M65C02 | M65816)
+	DI(M65816_ora, 3, ABS_IX,                 M6X)
+	DI(M65816_asl, 3, ABS_IX,                 M6X)
+	DI(M65816_ora, 4, ABS_LONG_IX,            M65816)
+
+	// 0x20
+	DI(M65816_jsr, 3, ABS,                    M6X)
+	DI(M65816_and, 2, DP_IX_INDIR,            M6X)
+	DI(M65816_jsl, 4, ABS_LONG,               M65816)
+	DI(M65816_and, 2, STACK_REL,              M65816)
+	DI(M65816_bit, 2, DP,                     M6X)
+	DI(M65816_and, 2, DP,                     M6X)
+	DI(M65816_rol, 2, DP,                     M6X)
+	DI(M65816_and, 2, DP_INDIR_LONG,          M65816)
+
+	// 0x28
+	DI(M65816_plp, 1, STACK_PULL,             M6X)
+	DV(M65816_and, 2, IMM,                    M6X, ACC16_INCBC)
+	DI(M65816_rol, 1, ACC,                    M6X)
+	DI(M65816_pld, 1, STACK_PULL,             M65816)
+	DI(M65816_bit, 3, ABS,                    M6X)
+	DI(M65816_and, 3, ABS,                    M6X)
+	DI(M65816_rol, 3, ABS,                    M6X)
+	DI(M65816_and, 4, ABS_LONG,               M65816)
+
+	// 0x30
+	DI(M65816_bmi, 2, PC_REL,                 M6X)
+	DI(M65816_and, 2, DP_INDIR_IY,            M6X)
+	DI(M65816_and, 2, DP_INDIR,               M65C02 | M65816)
+	DI(M65816_and, 2, STACK_REL_INDIR_IY,     M65816)
+	DI(M65816_bit, 2, DP_IX,                  M65C02 | M65816)
+	DI(M65816_and, 2, DP_IX,                  M6X)
+	DI(M65816_rol, 2, DP_IX,                  M6X)
+	DI(M65816_and, 2, DP_INDIR_LONG_IY,       M65816)
+
+	// 0x38
+	DI(M65816_sec, 1, IMPLIED,                M6X)
+	DI(M65816_and, 3, ABS_IY,                 M6X)
+	DI(M65816_dec, 1, ACC,                    M65C02 | M65816)
+	DI(M65816_tsc, 1, IMPLIED,                M65816)
+	DI(M65816_bit, 3, ABS_IX,                 M65C02 | M65816)
+	DI(M65816_and, 3, ABS_IX,                 M6X)
+	DI(M65816_rol, 3, ABS_IX,                 M6X)
+	DI(M65816_and, 4, ABS_LONG_IX,            M65816)
+
+	// 0x40
+	DI(M65816_rti, 1, STACK_RTI,              M6X)
+	DI(M65816_eor, 2, DP_IX_INDIR,            M6X)
+	DI(M65816_wdm, 2, IMPLIED,                M65816)
+	DI(M65816_eor, 2, STACK_REL,              M65816)
+	DI(M65816_mvp, 3, BLK_MOV,                M65816)
+	DI(M65816_eor, 2, DP,                     M6X)
+	DI(M65816_lsr, 2, DP,                     M6X)
+	DI(M65816_eor, 2, DP_INDIR_LONG,          M65816)
+
+	// 0x48
+	DI(M65816_pha, 1, STACK_PUSH,             M6X)
+	DV(M65816_eor, 2, IMM,                    M6X, ACC16_INCBC)
+	DI(M65816_lsr, 1, ACC,                    M6X)
+	DI(M65816_phk, 1, STACK_PUSH,             M65816)
+	DI(M65816_jmp, 3, ABS,                    M6X)
+	DI(M65816_eor, 3, ABS,                    M6X)
+	DI(M65816_lsr, 3, ABS,                    M6X)
+	DI(M65816_eor, 4, ABS_LONG,               M65816)
+
+	// 0x50
+	DI(M65816_bvc, 2, PC_REL,                 M6X)
+	DI(M65816_eor, 2, DP_INDIR_IY,            M6X)
+	DI(M65816_eor, 2, DP_INDIR,               M65C02 | M65816)
+	DI(M65816_eor, 2, STACK_REL_INDIR_IY,     M65816)
+	DI(M65816_mvn, 3, BLK_MOV,                M65816)
+	DI(M65816_eor, 2, DP_IX,                  M6X)
+	DI(M65816_lsr, 2, DP_IX,                  M6X)
+	DI(M65816_eor, 2, DP_INDIR_LONG_IY,       M65816)
+
+	// 0x58
+	DI(M65816_cli, 1, IMPLIED,                M6X)
+	DI(M65816_eor, 3, ABS_IY,                 M6X)
+	DI(M65816_phy, 1, STACK_PUSH,             M65C02 | M65816)
+	DI(M65816_tcd, 1, IMPLIED,                M65816)
+	DI(M65816_jml, 4, ABS_LONG,               M65816)
+	DI(M65816_eor, 3, ABS_IX,                 M6X)
+	DI(M65816_lsr, 3, ABS_IX,                 M6X)
+	DI(M65816_eor, 4, ABS_LONG_IX,            M65816)
+
+	// 0x60
+	DI(M65816_rts, 1, STACK_RTS,              M6X)
+	DI(M65816_adc, 2, DP_IX_INDIR,            M6X)
+	DI(M65816_per, 3, STACK_PC_REL,           M65816)
+	DI(M65816_adc, 2, STACK_REL,              M65816)
+	DI(M65816_stz, 2, DP,                     M65C02 | M65816)
+	DI(M65816_adc, 2, DP,                     M6X)
+	DI(M65816_ror, 2, DP,                     M6X)
+	DI(M65816_adc, 2, DP_INDIR_LONG,          M65816)
+
+	// 0x68
+	DI(M65816_pla, 1, STACK_PULL,             M6X)
+	DV(M65816_adc, 2, IMM,                    M6X, ACC16_INCBC)
+	DI(M65816_ror, 1, ACC,                    M6X)
+	DI(M65816_rtl, 1, STACK_RTL,              M65816)
+	DI(M65816_jmp, 3, ABS_INDIR,              M6X)
+	DI(M65816_adc, 3, ABS,                    M6X)
+	DI(M65816_ror, 3, ABS,                    M6X)
+	DI(M65816_adc, 4, ABS_LONG,               M65816)
+
+	// 0x70
+	DI(M65816_bvs, 2, PC_REL,                 M6X)
+	DI(M65816_adc, 2, DP_INDIR_IY,            M6X)
+	DI(M65816_adc, 2, DP_INDIR,               M65C02 | M65816)
+	DI(M65816_adc, 2, STACK_REL_INDIR_IY,     M65816)
+	DI(M65816_stz, 2, DP_IX,                  M65C02 | M65816)
+	DI(M65816_adc, 2, DP_IX,                  M6X)
+	DI(M65816_ror, 2, DP_IX,                  M6X)
+	DI(M65816_adc, 2, DP_INDIR_LONG_IY,       M65816)
+
+	// 0x78
+	DI(M65816_sei, 1, IMPLIED,                M6X)
+	DI(M65816_adc, 3, ABS_IY,                 M6X)
+	DI(M65816_ply, 1, STACK_PULL,             M65C02 | M65816)
+	DI(M65816_tdc, 1, IMPLIED,                M65816)
+	DI(M65816_jmp, 3, ABS_IX_INDIR,           M65C02 | M65816)
+	DI(M65816_adc, 3, ABS_IX,                 M6X)
+	DI(M65816_ror, 3, ABS_IX,                 M6X)
+	DI(M65816_adc, 4, ABS_LONG_IX,            M6X)
+
+	// 0x80
+	DI(M65816_bra, 2, PC_REL,                 M65C02 | M65816)
+	DI(M65816_sta, 2, DP_IX_INDIR,            M6X)
+	DI(M65816_brl, 3, PC_REL_LONG,            M65816)
+	DI(M65816_sta, 2, STACK_REL,              M65816)
+	DI(M65816_sty, 2, DP,                     M6X)
+	DI(M65816_sta, 2, DP,                     M6X)
+	DI(M65816_stx, 2, DP,                     M6X)
+	DI(M65816_sta, 2, DP_INDIR_LONG,          M65816)
+
+	// 0x88
+	DI(M65816_dey, 1, IMPLIED,                M6X)
+	DV(M65816_bit, 2, IMM,                    M65C02 | M65816, ACC16_INCBC)
+	DI(M65816_txa, 1, IMPLIED,                M6X)
+	DI(M65816_phb, 1, STACK_PUSH,             M65816)
+	DI(M65816_sty, 3, ABS,                    M6X)
+	DI(M65816_sta, 3, ABS,                    M6X)
+	DI(M65816_stx, 3, ABS,                    M6X)
+	DI(M65816_sta, 4, ABS_LONG,               M65816)
+
+	// 0x90
+	DI(M65816_bcc, 2, PC_REL,                 M6X)
+	DI(M65816_sta, 2, DP_INDIR_IY,            M6X)
+	DI(M65816_sta, 2, DP_INDIR,               M65C02 | M65816)
+	DI(M65816_sta, 2, STACK_REL_INDIR_IY,     M65816)
+	DI(M65816_sty, 2, DP_IX,                  M6X)
+	DI(M65816_sta, 2, DP_IX,                  M6X)
+	DI(M65816_stx, 2, DP_IY,                  M6X)
+	DI(M65816_sta, 2, DP_INDIR_LONG_IY,       M65816)
+
+	// 0x98
+	DI(M65816_tya, 1, IMPLIED,                M6X)
+	DI(M65816_sta, 3, ABS_IY,                 M6X)
+	DI(M65816_txs, 1, IMPLIED,                M6X)
+	DI(M65816_txy, 1, IMPLIED,                M65816)
+	DI(M65816_stz, 3, ABS,                    M65C02 | M65816)
+	DI(M65816_sta, 3, ABS_IX,                 M6X)
+	DI(M65816_stz, 3, ABS_IX,                 M65C02 | M65816)
+	DI(M65816_sta, 4, ABS_LONG_IX,            M65816)
+
+	// 0xa0
+	DV(M65816_ldy, 2, IMM,                    M6X, XY16_INCBC)
+	DI(M65816_lda, 2, DP_IX_INDIR,            M6X)
+	DV(M65816_ldx, 2, IMM,                    M6X, XY16_INCBC)
+	DI(M65816_lda, 2, STACK_REL,              M65816)
+	DI(M65816_ldy, 2, DP,                     M6X)
+	DI(M65816_lda, 2, DP,                     M6X)
+	DI(M65816_ldx, 2, DP,                     M6X)
+	DI(M65816_lda, 2, DP_INDIR_LONG,          M65816)
+
+	// 0xa8
+	DI(M65816_tay, 1, IMPLIED,                M6X)
+	DV(M65816_lda, 2, IMM,                    M6X, ACC16_INCBC)
+	DI(M65816_tax, 1, IMPLIED,                M6X)
+	DI(M65816_plb, 1, STACK_PULL,             M65816)
+	DI(M65816_ldy, 3, ABS,                    M6X)
+	DI(M65816_lda, 3, ABS,                    M6X)
+	DI(M65816_ldx, 3, ABS,                    M6X)
+	DI(M65816_lda, 4, ABS_LONG,               M65816)
+
+	// 0xb0
+	DI(M65816_bcs, 2, PC_REL,                 M6X)
+	DI(M65816_lda, 2, DP_INDIR_IY,            M6X)
+	DI(M65816_lda, 2, DP_INDIR,               M65C02 | M65816)
+	DI(M65816_lda, 2, STACK_REL_INDIR_IY,     M65816)
+	DI(M65816_ldy, 2, DP_IX,                  M6X)
+	DI(M65816_lda, 2, DP_IX,                  M6X)
+	DI(M65816_ldx, 2, DP_IY,                  M6X)
+	DI(M65816_lda, 2, DP_INDIR_LONG_IY,       M65816)
+
+	// 0xb8
+	DI(M65816_clv, 1, IMPLIED,                M6X)
+	DI(M65816_lda, 3, ABS_IY,                 M6X)
+	DI(M65816_tsx, 1, IMPLIED,                M6X)
+	DI(M65816_tyx, 1, IMPLIED,                M65816)
+	DI(M65816_ldy, 3, ABS_IX,                 M6X)
+	DI(M65816_lda, 3, ABS_IX,                 M6X)
+	DI(M65816_ldx, 3, ABS_IY,                 M6X)
+	DI(M65816_lda, 4, ABS_LONG_IX,            M65816)
+
+	// 0xc0
+	DV(M65816_cpy, 2, IMM,                    M6X, XY16_INCBC)
+	DI(M65816_cmp, 2, DP_IX_INDIR,            M6X)
+	DI(M65816_rep, 2, IMM,                    M65816)
+	DI(M65816_cmp, 2, STACK_REL,              M65816)
+	DI(M65816_cpy, 2, DP,                     M6X)
+	DI(M65816_cmp, 2, DP,                     M6X)
+	DI(M65816_dec, 2, DP,                     M6X)
+	DI(M65816_cmp, 2, DP_INDIR_LONG,          M65816)
+
+	// 0xc8
+	DI(M65816_iny, 1, IMPLIED,                M6X)
+	DV(M65816_cmp, 2, IMM,                    M6X, ACC16_INCBC)
+	DI(M65816_dex, 1, IMPLIED,                M6X)
+	DI(M65816_wai, 1, IMPLIED,                M65816)
+	DI(M65816_cpy, 3, ABS,                    M6X)
+	DI(M65816_cmp, 3, ABS,                    M6X)
+	DI(M65816_dec, 3, ABS,                    M6X)
+	DI(M65816_cmp, 4, ABS_LONG,               M65816)
+
+	// 0xd0
+	DI(M65816_bne, 2, PC_REL,                 M6X)
+	DI(M65816_cmp, 2, DP_INDIR_IY,            M6X)
+	DI(M65816_cmp, 2, DP_INDIR,               M65C02 | M65816)
+	DI(M65816_cmp, 2, STACK_REL_INDIR_IY,     M65816)
+	DI(M65816_pei, 2, STACK_DP_INDIR,         M65816)
+	DI(M65816_cmp, 2, DP_IX,                  M6X)
+	DI(M65816_dec, 2, DP_IX,                  M6X)
+	DI(M65816_cmp, 2, DP_INDIR_LONG_IY,       M65816)
+
+	// 0xd8
+	DI(M65816_cld, 1, IMPLIED,                M6X)
+	DI(M65816_cmp, 3, ABS_IY,                 M6X)
+	DI(M65816_phx, 1, STACK_PUSH,             M65C02 | M65816)
+	DI(M65816_stp, 1, IMPLIED,                M65816)
+	DI(M65816_jmp, 3, ABS_INDIR_LONG,         M65816)
+	DI(M65816_cmp, 3, ABS_IX,                 M6X)
+	DI(M65816_dec, 3, ABS_IX,                 M6X)
+	DI(M65816_cmp, 4, ABS_LONG_IX,            M65816)
+
+	// 0xe0
+	DV(M65816_cpx, 2, IMM,                    M6X, XY16_INCBC)
+	DI(M65816_sbc, 2, DP_IX_INDIR,            M6X)
+	DI(M65816_sep, 2, IMM,                    M65816)
+	DI(M65816_sbc, 2, STACK_REL,              M65816)
+	DI(M65816_cpx, 2, DP,                     M6X)
+	DI(M65816_sbc, 2, DP,                     M6X)
+	DI(M65816_inc, 2, DP,                     M6X)
+	DI(M65816_sbc, 2, DP_INDIR_LONG,          M65816)
+
+	// 0xe8
+	DI(M65816_inx, 1, IMPLIED,                M6X)
+	DV(M65816_sbc, 2, IMM,                    M6X, ACC16_INCBC)
+	DI(M65816_nop, 1, IMPLIED,                M6X)
+	DI(M65816_xba, 1, IMPLIED,                M65816)
+	DI(M65816_cpx, 3, ABS,                    M6X)
+	DI(M65816_sbc, 3, ABS,                    M6X)
+	DI(M65816_inc, 3, ABS,                    M6X)
+	DI(M65816_sbc, 4, ABS_LONG,               M65816)
+
+	// 0xf0
+	DI(M65816_beq, 2, PC_REL,                 M6X)
+	DI(M65816_sbc, 2, DP_INDIR_IY,            M6X)
+	DI(M65816_sbc, 2, DP_INDIR,               M65C02 | M65816)
+	DI(M65816_sbc, 2, STACK_REL_INDIR_IY,     M65816)
+	DI(M65816_pea, 3, STACK_ABS,              M65816)
+	DI(M65816_sbc, 2, DP_IX,                  M6X)
+	DI(M65816_inc, 2, DP_IX,                  M6X)
+	DI(M65816_sbc, 2, DP_INDIR_LONG_IY,       M65816)
+
+	// 0xf8
+	DI(M65816_sed, 1, IMPLIED,                M6X)
+	DI(M65816_sbc, 3, ABS_IY,                 M6X)
+	DI(M65816_plx, 1, STACK_PULL,             M65C02 | M65816)
+	DI(M65816_xce, 1, IMPLIED,                M65816)
+	DI(M65816_jsr, 3, ABS_IX_INDIR,           M65816)
+	DI(M65816_sbc, 3, ABS_IX,                 M6X)
+	DI(M65816_inc, 3, ABS_IX,                 M6X)
+	DI(M65816_sbc, 4, ABS_LONG_IX,            M65816)
+};
+
+#undef DI
+#undef DV
+
+
+// Number of operand bytes following the opcode, per addressing mode.
+// IMM is listed with its 8-bit size; see get_insn_size().
+static constexpr uint8_t operand_sizes[] =
+{
+	2, // ABS
+	2, // ABS_IX,
+	2, // ABS_IY,
+	2, // ABS_IX_INDIR,
+	2, // ABS_INDIR,
+	2, // ABS_INDIR_LONG,
+	3, // ABS_LONG,
+	3, // ABS_LONG_IX,
+	0, // ACC,
+	2, // BLK_MOV,
+	1, // DP,
+	1, // DP_IX,
+	1, // DP_IY,
+	1, // DP_IX_INDIR,
+	1, // DP_INDIR,
+	1, // DP_INDIR_LONG,
+	1, // DP_INDIR_IY,
+	1, // DP_INDIR_LONG_IY,
+	1, // IMM,
+	0, // IMPLIED,
+	1, // PC_REL,
+	2, // PC_REL_LONG,
+	2, // STACK_ABS,
+	1, // STACK_DP_INDIR,
+	1, // STACK_INT,
+	2, // STACK_PC_REL,
+	0, // STACK_PULL,
+	0, // STACK_PUSH,
+	0, // STACK_RTI,
+	0, // STACK_RTL,
+	0, // STACK_RTS,
+	1, // STACK_REL,
+	1  // STACK_REL_INDIR_IY,
+};
+
+static_assert(sizeof(operand_sizes) == ADDRMODE_last, "operand_sizes out of sync with m65_addrmode_t");
+
+
+// ---------------------------------------------------------------------------
+// Instructions whose memory operand has the width of X/Y rather than A
+static constexpr bool is_index_op(m65_itype_t itype, m65_addrmode_t addr)
+{
+	switch (itype)
+	{
+	case M65816_ldx:
+	case M65816_ldy:
+		return true;
+	case M65816_stx:
+	case M65816_sty:
+		return addr != ABS_IX && addr != ABS_IY;
+	case M65816_cpx:
+	case M65816_cpy:
+		return addr == ABS || addr == DP;
+	default:
+		return false;
+	}
+}
+
+// ---------------------------------------------------------------------------
+static constexpr m65_decode_entry_t make_decode_entry(uint8_t code, m65_mode_t mode)
+{
+	const struct opcode_info_t& opinfo = opinfos[code];
+	m65_itype_t itype = opinfo.itype;
+	bool acc16 = mode_acc_16(mode);
+	bool xy16 = mode_xy_16(mode);
+	uint8_t opsize = operand_sizes[opinfo.addr];
+	uint8_t optype = M65_O_VOID;
+	uint8_t dtype = M65_DT_BYTE;
+	uint8_t phrase = 0;
+	uint8_t flags = 0;
+
+	// Width of a memory operand: that of A, or that of X/Y
+	uint8_t mem_dtype = (is_index_op(itype, opinfo.addr) ? xy16 : acc16) ? M65_DT_WORD : M65_DT_BYTE;
+
+	switch (opinfo.addr)
+	{
+	case ACC:
+	case STACK_PUSH:
+	case STACK_PULL:
+	case STACK_RTS:
+	case STACK_RTI:
+	case STACK_RTL:
+	case IMPLIED:
+		break;
+	case STACK_INT:
+		// COP & BRK; they are 1-byte, but have
+		// another, signature byte.
+		optype = M65_O_IMM;
+		break;
+	case STACK_ABS:
+		// Always 16 bits
+		optype = M65_O_IMM;
+		dtype = M65_DT_WORD;
+		break;
+	case STACK_REL:
+		optype = M65_O_DISPL;
+		phrase = rS;
+		break;
+	case STACK_REL_INDIR_IY:
+		optype = M65_O_DISPL;
+		phrase = rSiY;
+		break;
+	case STACK_PC_REL:
+		optype = M65_O_NEAR;
+		dtype = M65_DT_WORD;
+		flags = M65_DF_PCREL;
+		break;
+	case STACK_DP_INDIR:
+		optype = M65_O_DISPL;
+		phrase = rSDi;
+		dtype = M65_DT_WORD;
+		break;
+	case IMM:
+		optype = M65_O_IMM;
+		if (((opinfo.flags & ACC16_INCBC) && acc16)
+			|| ((opinfo.flags & XY16_INCBC) && xy16))
+		{
+			opsize++;
+			dtype = M65_DT_WORD;
+		}
+		break;
+	case ABS:
+		flags = M65_DF_TARGET;
+		if (itype == M65816_jsr || itype == M65816_jmp)
+		{
+			optype = M65_O_NEAR;
+			dtype = M65_DT_WORD;
+		}
+		else
+		{
+			optype = M65_O_MEM;
+			dtype = mem_dtype;
+		}
+		break;
+	case ABS_LONG:
+		flags = M65_DF_TARGET;
+		if (itype == M65816_jsl || itype == M65816_jml)
+		{
+			optype = M65_O_FAR;
+		}
+		else
+		{
+			optype = M65_O_MEM_FAR;
+			dtype = mem_dtype;
+		}
+		break;
+	case ABS_IX:
+	case ABS_IY:
+		optype = M65_O_DISPL;
+		phrase = opinfo.addr == ABS_IX ? rAbsX : rAbsY;
+		dtype = mem_dtype;
+		break;
+	case ABS_LONG_IX:
+		optype = M65_O_DISPL;
+		phrase = rAbsLX;
+		dtype = mem_dtype;
+		break;
+	case ABS_INDIR:
+		optype = M65_O_DISPL;
+		phrase = rAbsi;
+		dtype = M65_DT_WORD;
+		break;
+	case ABS_INDIR_LONG:
+		optype = M65_O_DISPL;
+		phrase = rAbsiL;
+		dtype = M65_DT_WORD;
+		break;
+	case ABS_IX_INDIR:
+		optype = M65_O_DISPL;
+		phrase = rAbsXi;
+		dtype = M65_DT_WORD;
+		if (itype >= M65816_jml && itype <= M65816_jsr)
+			flags = M65_DF_TARGET;
+		break;
+	case DP:
+		optype = M65_O_DISPL;
+		phrase = rD;
+		dtype = mem_dtype;
+		break;
+	case DP_IX:
+	case DP_IY:
+		optype = M65_O_DISPL;
+		phrase = opinfo.addr == DP_IX ? rDX : rDY;
+		dtype = mem_dtype;
+		break;
+	case DP_IX_INDIR:
+		optype = M65_O_DISPL;
+		phrase = riDX;
+		dtype = mem_dtype;
+		break;
+	case DP_INDIR:
+		optype = M65_O_DISPL;
+		phrase = rDi;
+		dtype = mem_dtype;
+		break;
+	case DP_INDIR_LONG:
+		optype = M65_O_DISPL;
+		phrase = rDiL;
+		dtype = mem_dtype;
+		break;
+	case DP_INDIR_IY:
+		optype = M65_O_DISPL;
+		phrase = rDiY;
+		dtype = mem_dtype;
+		break;
+	case DP_INDIR_LONG_IY:
+		optype = M65_O_DISPL;
+		phrase = rDiLY;
+		dtype = mem_dtype;
+		break;
+	case PC_REL:
+		optype = M65_O_NEAR;
+		dtype = M65_DT_WORD;
+		flags = M65_DF_TARGET | M65_DF_PCREL;
+		break;
+	case PC_REL_LONG:
+		optype = M65_O_FAR;
+		dtype = M65_DT_WORD;
+		flags = M65_DF_TARGET | M65_DF_PCREL;
+		break;
+	case BLK_MOV:
+		// Two 8-bit operands; the analyzer splits them.
+		optype = M65_O_IMM;
+		break;
+	default:
+		break;
+	}
+
+	return m65_decode_entry_t{ uint8_t(itype), uint8_t(opinfo.addr), uint8_t(1 + opsize), opsize,
+		optype, dtype, phrase, flags };
+}
+
+// One row per (m, x, e) combination, 256 opcodes each.
+struct decode_table_t
+{
+	m65_decode_entry_t entries[8][256];
+};
+
+// ---------------------------------------------------------------------------
+static constexpr decode_table_t make_decode_table()
+{
+	decode_table_t table = {};
+	for (int mode = 0; mode < 8; mode++)
+		for (int code = 0; code < 256; code++)
+			table.entries[mode][code] = make_decode_entry(uint8_t(code), m65_mode_t(mode));
+	return table;
+}
+
+static constexpr decode_table_t decode_table = make_decode_table();
+
+static_assert(decode_table.entries[0][0xA9].size == 3, "LDA #imm must be 3 bytes with a 16-bit accumulator");
+static_assert(decode_table.entries[M65_MODE_M][0xA9].size == 2, "LDA #imm must be 2 bytes with an 8-bit accumulator");
+static_assert(decode_table.entries[M65_MODE_E][0xA2].size == 2, "LDX #imm must be 2 bytes in emulation mode");
+static_assert(decode_table.entries[M65_MODE_M][0xA2].size == 3, "LDX #imm must follow X, not M");
+
+
+// ---------------------------------------------------------------------------
+const struct opcode_info_t& get_opcode_info(uint8_t opcode)
+{
+	return opinfos[opcode];
+}
+
+// ---------------------------------------------------------------------------
+const m65_decode_entry_t& get_decode_entry(uint8_t opcode, m65_mode_t mode)
+{
+	return decode_table.entries[mode & 7][opcode];
+}
+
+// ---------------------------------------------------------------------------
+size_t get_insn_size(uint8_t opcode, m65_mode_t mode)
+{
+	return get_decode_entry(opcode, mode).size;
+}
+
+// ---------------------------------------------------------------------------
+size_t decode_bytes(const uint8_t* bytes, size_t len, uint32_t ea, m65_mode_t mode,
+	m65_decoded_t* out, const uint8_t* cop_sizes)
+{
+	if (len == 0)
+		return 0;
+
+	uint8_t code = bytes[0];
+	const m65_decode_entry_t& entry = get_decode_entry(code, mode);
+	size_t size = entry.size;
+	if (size > len)
+		return 0;
+
+	uint32_t operand = 0;
+	for (size_t i = size - 1; i > 0; i--)
+		operand = (operand << 8) | bytes[i];
+
+	uint32_t target = M65_NO_TARGET;
+	uint32_t bank = ea & 0xFF0000;
+	switch (entry.addr)
+	{
+	case PC_REL:
+		target = bank | uint16_t(ea + size + int8_t(operand));
+		break;
+	case PC_REL_LONG:
+	case STACK_PC_REL:
+		target = bank | uint16_t(ea + size + int16_t(operand));
+		break;
+	case ABS:
+		if (entry.itype == M65816_jsr || entry.itype == M65816_jmp)
+			target = bank | operand;
+		break;
+	case ABS_LONG:
+		if (entry.itype == M65816_jsl || entry.itype == M65816_jml)
+			target = operand;
+		break;
+	case STACK_INT:
+		// COP arguments follow the signature byte
+		if (cop_sizes != nullptr && entry.itype == M65816_cop)
+		{
+			size += cop_sizes[operand & 0xFF];
+			if (size > len)
+				return 0;
+		}
+		break;
+	default:
+		break;
+	}
+
+	out->ea = ea;
+	out->operand = operand;
+	out->target = target;
+	out->opcode = code;
+	out->itype = entry.itype;
+	out->addr = entry.addr;
+	out->size = uint8_t(size);
+	out->mode = mode;
+	return size;
+}
+
+// ---------------------------------------------------------------------------
+size_t decode_range(const uint8_t* rom, size_t len, uint32_t base, m65_mode_t mode,
+	m65_decoded_t* out, size_t max_out, const uint8_t* cop_sizes)
+{
+	size_t count = 0, offset = 0;
+	uint8_t prev_itype = M65816_null;
+
+	while (count < max_out && offset < len)
+	{
+		m65_decoded_t& d = out[count];
+		size_t size = decode_bytes(rom + offset, len - offset, base + uint32_t(offset), mode, &d, cop_sizes);
+		if (size == 0)
+			break;
+
+		switch (d.itype)
+		{
+		case M65816_sep:
+		case M65816_rep:
+		{
+			m65_mode_t bits = ((d.operand & 0x20) ? M65_MODE_M : 0)
+				| ((d.operand & 0x10) ? M65_MODE_X : 0);
+			if (d.itype == M65816_sep)
+				mode |= bits;
+			else
+				mode &= m65_mode_t(~bits);
+		}
+		break;
+		case M65816_xce:
+			if (prev_itype == M65816_clc)
+				mode &= ~M65_MODE_E;
+			else if (prev_itype == M65816_sec)
+				mode |= M65_MODE_E;
+			break;
+		}
+
+		// M and X stay set in emulation mode, and are still set
+		// when leaving it
+		if (mode & M65_MODE_E)
+			mode |= M65_MODE_M | M65_MODE_X;
+
+		prev_itype = d.itype;
+		offset += size;
+		count++;
+	}
+
+	return count;
+}
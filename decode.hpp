@@ -0,0 +1,290 @@
+#ifndef __DECODE_HPP__
+#define __DECODE_HPP__
+
+#include <stddef.h>
+#include <stdint.h>
+#include "ins.hpp"
+
+// Standalone 65816 instruction decoder.
+//
+// Nothing in here depends on the IDA SDK: instructions are decoded
+// from a plain byte buffer, with the processor mode passed in by the
+// caller rather than looked up in the segment registers. The IDA
+// analyzer (m65816_t::ana) is a thin adapter on top of this, and
+// the same code can be used for linear sweeps, fuzzing or benchmarks
+// over raw ROM images.
+
+
+enum M65816_registers
+{
+	rA,   // Accumulator
+	rX,   // X index
+	rY,   // Y index
+	rS,   // Stack
+	rCs,  // code segment
+	rDs,  // data segment
+
+	// This will hold the value of B, the
+	// data bank register. We won't make use of Ds
+	// directly, as it is typically used, in computation,
+	// as a 16-byte paragraph register, while B is a
+	// 64KB pages register. Also, by having a dedicated
+	// B, the user will be able to modify it more
+	// easily (without having to manually shift the value by
+	// 12 bits).
+	// Note: Also, we won't have this register ``mapped'' to a sel_t.
+	// We'll stuff the B value in there directly, which allows
+	// it to be more versatile, and access banks where there's
+	// no ROM loaded (such as [S|W]RAM bank(s)).
+	rB,
+
+	// Direct page register. Same note as that of rB applies.
+	rD,
+
+	// These will be considered segment
+	// registers by IDA (just as rCs, rDs, rB and rD),
+	// but we'll actually use them to keep information
+	// about the 'm', 'x' and 'e' flags, determining
+	// what's the accumulator & indices mode, and whether
+	// we run in 6502 emulation or 65816 native mode.
+	rFm,
+	rFx,
+	rFe,
+
+	// program bank register
+	rPB,
+
+	rOm,
+	rOx,
+
+	// Packed processor state: M, X and E together, plus a tag
+	// telling where the value came from (see pstate_bits_t).
+	// rFm, rFx, rFe, rOm and rOx are only kept so that older
+	// databases can be converted to it.
+	rP
+};
+
+
+// The various phrases that can be used in case
+// an operand is of type 'o_displ'.
+enum odispl_phrases_t
+{
+	rDX = 100, // "dp, X"              DP_IX
+	rDY,       // "dp, Y"              DP_IY
+	riDX,      // "(dp, X)"            DP_IX_INDIR
+	rAbsi,     // "(abs)"              ABS_INDIR
+	rAbsiL,    // "long(abs)"          ABS_INDIR_LONG
+	rAbsX,     // "abs, X"             ABS_IX
+	rAbsY,     // "abs, Y"             ABS_IY
+	rAbsLX,    // "long abs, X"        ABS_LONG_IX
+	rAbsXi,    // "(abs,X)"            ABS_IX_INDIR
+	rDi,       // "(dp,n)"             DP_INDIR
+	rDiL,      // "long(dp,n)"         DP_INDIR_LONG
+	rDiY,      // "(dp,n), Y"          DP_INDIR_IY
+	rDiLY,     // "long(dp,n), Y"      DP_INDIR_LONG_IY
+	rSiY,      // (s,n),Y              STACK_REL_INDIR_IY
+	rSDi       // "(dp,n)"             STACK_DP_INDIR
+};
+
+
+// Addressing modes
+enum m65_addrmode_t
+{
+	ABS = 0,
+	ABS_IX,
+	ABS_IY,
+	ABS_IX_INDIR,
+	ABS_INDIR,
+	ABS_INDIR_LONG,
+	ABS_LONG,
+	ABS_LONG_IX,
+	ACC,
+	BLK_MOV,
+	DP,
+	DP_IX,
+	DP_IY,
+	DP_IX_INDIR,
+	DP_INDIR,
+	DP_INDIR_LONG,
+	DP_INDIR_IY,
+	DP_INDIR_LONG_IY,
+	IMM,
+	IMPLIED,
+	PC_REL,
+	PC_REL_LONG,
+	STACK_ABS,
+	STACK_DP_INDIR,
+	STACK_INT,
+	STACK_PC_REL,
+	STACK_PULL,
+	STACK_PUSH,
+	STACK_RTI,
+	STACK_RTL,
+	STACK_RTS,
+	STACK_REL,
+	STACK_REL_INDIR_IY,
+	ADDRMODE_last
+};
+
+
+// The type of m65* processors. Used
+// to declare availability of certain opcodes depending
+// on the processor.
+enum m65_variant_t
+{
+	M6502 = 1,
+	M65C02 = 2,
+	M65802 = 4,
+	M65816 = 8,
+	M6X = 1 | 2 | 4 | 8
+};
+
+
+// Special flags, for certain opcodes
+enum opcode_flags_t
+{
+	// Increment instruction's byte count
+	// if accumulator is in 16-bits mode.
+	ACC16_INCBC = 1,
+
+	// Increment instruction's byte count
+	// if X/Y registers are in 16-bits mode.
+	XY16_INCBC = 2
+};
+
+// Information about an opcode
+struct opcode_info_t
+{
+	m65_itype_t    itype;
+	m65_addrmode_t addr;
+	uint8_t        cpu_variants; // OR'd m65_variant_t
+	uint16_t       flags;        // OR'd opcode_flags_t
+};
+
+const struct opcode_info_t& get_opcode_info(uint8_t opcode);
+
+
+// Processor state the decoder depends on, as OR'd m65_mode_bits_t.
+typedef uint8_t m65_mode_t;
+
+enum m65_mode_bits_t
+{
+	M65_MODE_M = 1, // Accumulator is 8 bits
+	M65_MODE_X = 2, // Index registers are 8 bits
+	M65_MODE_E = 4  // 6502 emulation mode (forces both of the above)
+};
+
+constexpr bool mode_acc_16(m65_mode_t mode) { return (mode & (M65_MODE_M | M65_MODE_E)) == 0; }
+constexpr bool mode_xy_16(m65_mode_t mode) { return (mode & (M65_MODE_X | M65_MODE_E)) == 0; }
+
+// Longest instruction, not counting COP arguments.
+#define M65_MAX_INSN_SIZE 4
+
+// 'target' value of instructions that have no static target.
+#define M65_NO_TARGET 0xFFFFFFFF
+
+// A decoded instruction.
+struct m65_decoded_t
+{
+	uint32_t   ea;      // Address of the instruction
+	uint32_t   operand; // Operand bytes, little-endian (at most 24 bits)
+	uint32_t   target;  // Static branch/jump target, or M65_NO_TARGET
+	uint8_t    opcode;
+	uint8_t    itype;   // m65_itype_t
+	uint8_t    addr;    // m65_addrmode_t
+	uint8_t    size;    // Length in bytes, including COP arguments
+	m65_mode_t mode;    // Mode the instruction was decoded with
+};
+
+
+// Operand types and data types used by the decode table. The values
+// are the same as IDA's optype_t/op_dtype_t (checked in ana.cpp), so
+// the analyzer can store them in op_t as they are.
+enum m65_optype_t
+{
+	M65_O_VOID = 0,
+	M65_O_MEM = 2,
+	M65_O_DISPL = 4,
+	M65_O_IMM = 5,
+	M65_O_FAR = 6,
+	M65_O_NEAR = 7,
+	M65_O_MEM_FAR = 8  // o_mem_far
+};
+
+enum m65_dtype_t
+{
+	M65_DT_BYTE = 0,
+	M65_DT_WORD = 1
+};
+
+enum m65_decode_flags_t
+{
+	// The operand is the target of a jump/call, and should
+	// be recorded in 'full_target_ea'.
+	M65_DF_TARGET = 1,
+
+	// The operand is a displacement relative to the next instruction.
+	M65_DF_PCREL = 2
+};
+
+// Everything the analyzer needs to know about an opcode, once
+// the M, X and E flags are known.
+struct m65_decode_entry_t
+{
+	uint8_t itype;  // m65_itype_t
+	uint8_t addr;   // m65_addrmode_t
+	uint8_t size;   // Instruction length (COP arguments excluded)
+	uint8_t opsize; // Number of operand bytes following the opcode
+	uint8_t optype; // m65_optype_t of the first operand
+	uint8_t dtype;  // m65_dtype_t of the first operand
+	uint8_t phrase; // Register or odispl_phrases_t, for M65_O_DISPL
+	uint8_t flags;  // OR'd m65_decode_flags_t
+};
+
+/**
+ * Decode table lookup. The table is generated at compile time,
+ * for each opcode and each combination of the M, X and E flags.
+ */
+const m65_decode_entry_t& get_decode_entry(uint8_t opcode, m65_mode_t mode);
+
+
+/**
+ * Length of the instruction starting with 'opcode', in the given mode.
+ *
+ * For COP, this is the length of the opcode and its signature byte;
+ * arguments are not included.
+ */
+size_t get_insn_size(uint8_t opcode, m65_mode_t mode);
+
+
+/**
+ * Decode a single instruction.
+ *
+ * bytes     : Instruction bytes.
+ * len       : Number of bytes available in 'bytes'.
+ * ea        : Address of the instruction, used for branch targets.
+ * mode      : Processor mode to decode with.
+ * out       : Receives the decoded instruction.
+ * cop_sizes : Optional 256-entry table giving the size of the
+ *             arguments that follow each COP signature byte.
+ *
+ * returns   : The length of the instruction, or 0 if 'len' is too short.
+ */
+size_t decode_bytes(const uint8_t* bytes, size_t len, uint32_t ea, m65_mode_t mode,
+	m65_decoded_t* out, const uint8_t* cop_sizes = nullptr);
+
+
+/**
+ * Linear sweep over a buffer.
+ *
+ * Decodes back-to-back instructions starting at rom[0] (mapped at 'base'),
+ * until the buffer or 'max_out' is exhausted. The mode is updated along
+ * the way for SEP/REP, and for XCE preceded by CLC/SEC, the same way
+ * emu() does it. M and X are forced set while in emulation mode.
+ *
+ * returns : The number of instructions stored in 'out'.
+ */
+size_t decode_range(const uint8_t* rom, size_t len, uint32_t base, m65_mode_t mode,
+	m65_decoded_t* out, size_t max_out, const uint8_t* cop_sizes = nullptr);
+
+#endif
@@ -36,7 +36,8 @@ void m65816_t::handle_operand(const op_t& x, bool read_access, const insn_t& ins
 		case rDiY:      // "(dp,n), Y"
 		case rDiLY:     // "long(dp,n), Y"
 		{
-			sel_t dp = get_sreg(insn.ea, rD);
+			cp_value_t d = consts.d_before(insn.ea);
+			sel_t dp = d != CP_UNKNOWN ? sel_t(d) : get_cpu_mode(insn.ea).dp;
 			if (dp != BADSEL)
 			{
 				ea_t orig_ea = dp + x.addr;
@@ -246,26 +247,36 @@ int m65816_t::emu(const insn_t& insn)
 	}
 #endif
 
+	switch (insn.itype)
+	{
+	case M65816_sep:
+	case M65816_rep:
+	case M65816_xce:
+	case M65816_plp:
+	case M65816_jsr:
+	case M65816_jsl:
+		// The flags change in this function; see mx_flow_t
+		mxflow.mark(insn.ea);
+		break;
+	}
+
 	switch (insn.itype)
 	{
 	case M65816_sep:
 	case M65816_rep:
 	{
 		// Switching 8 -> 16 bits modes.
-		uint8 flag_data = get_byte(insn.ea + 1);
-		uint8 m_flag = flag_data & 0x20;
-		uint8 x_flag = flag_data & 0x10;
-		uint8 val = (insn.itype == M65816_rep) ? 0 : 1;
-
-
-		if (m_flag) {
-			split_sreg_range(insn.ea + 2, rFm, val, SR_auto);
-			split_sreg_range(insn.ea + 2, rOm, val ? 0 : 1, SR_auto);
-		}
-		if (x_flag) {
-			split_sreg_range(insn.ea + 2, rFx, val, SR_auto);
-			split_sreg_range(insn.ea + 2, rOx, val ? 0 : 1, SR_auto);
-		}
+		// The operand uses the same bit positions as rP.
+		sel_t flag_data = get_byte(insn.ea + 1) & (PS_M | PS_X);
+		if (flag_data == 0)
+			break;
+
+		sel_t p = get_pstate(insn.ea);
+		if (insn.itype == M65816_rep)
+			p &= ~flag_data;
+		else
+			p |= flag_data;
+		split_sreg(insn.ea + 2, rP, p | PS_ORG_INSN);
 	}
 	break;
 
@@ -275,9 +286,9 @@ int m65816_t::emu(const insn_t& insn)
 		uint8 prev = get_byte(insn.ea - 1);
 		const struct opcode_info_t& opinf = get_opcode_info(prev);
 		if (opinf.itype == M65816_clc)
-			split_sreg_range(insn.ea + 1, rFe, 0, SR_auto);
+			split_sreg(insn.ea + 1, rP, (get_pstate(insn.ea) & ~PS_E) | PS_ORG_INSN);
 		else if (opinf.itype == M65816_sec)
-			split_sreg_range(insn.ea + 1, rFe, 1, SR_auto);
+			split_sreg(insn.ea + 1, rP, get_pstate(insn.ea) | PS_E | PS_M | PS_X | PS_ORG_INSN);
 	}
 	break;
 
@@ -304,53 +315,59 @@ int m65816_t::emu(const insn_t& insn)
 			//split_sreg_range(ftea, rDs, get_sreg(insn.ea, rDs), SR_auto);
 			//split_sreg_range(ftea, rD, get_sreg(insn.ea, rD), SR_auto);
 
-			if (insn.itype == M65816_jsl || insn.itype == M65816_jsr) {
-
-				func_t* func = get_func(ftea);
-				if (!func) {
-					add_func(ftea);
-					func = get_func(ftea);
-				}
-
-				if (func)
-					xfer_sregs_return(insn, func);
-			}
+			// The state after the call comes from the callee's
+			// summary; see call_graph_t and mx_flow_t
+			if ((insn.itype == M65816_jsl || insn.itype == M65816_jsr) && !get_func(ftea))
+				add_func(ftea);
 		}
 	}
 	break;
 
 	case M65816_plb:
 	{
-		int32 val = backtrack_value(insn.ea, 1, BT_STACK);
+		// Pushed in the same block, or else wherever backtracking finds it
+		int32 val = consts.db_after(insn.ea);
+		if (val == CP_UNKNOWN)
+			val = backtrack_value(insn.ea, 1, BT_STACK);
 		if (val != -1)
 		{
-			split_sreg_range(insn.ea + insn.size, rB, val, SR_auto);
-			split_sreg_range(insn.ea + insn.size, rDs, val << 12, SR_auto);
+			split_sreg(insn.ea + insn.size, rB, val);
+			split_sreg(insn.ea + insn.size, rDs, val << 12);
 		}
 	}
 	break;
 
 	case M65816_pld:
 	{
-		int32 val = backtrack_value(insn.ea, 2, BT_STACK);
+		int32 val = consts.d_after(insn.ea);
+		if (val == CP_UNKNOWN)
+			val = backtrack_value(insn.ea, 2, BT_STACK);
 		if (val != -1)
-			split_sreg_range(insn.ea + insn.size, rD, val, SR_auto);
+			split_sreg(insn.ea + insn.size, rD, val);
+	}
+	break;
+
+	case M65816_tcd:
+	{
+		int32 val = consts.d_after(insn.ea);
+		if (val == CP_UNKNOWN)
+			val = backtrack_value(insn.ea, 2, BT_A);
+		if (val != -1)
+			split_sreg(insn.ea + insn.size, rD, val);
 	}
 	break;
 
 	case M65816_plp:
 	{
-		// Ideally, should pass another parameter, specifying when to stop
-		// backtracking.
-		// For example, in order to avoid this:
-		//     PHP
-		//     PLP <-- this one is causing interference
-		//             (dunno if that even happens, though)
-		//     PLP
-		ea_t ea = backtrack_prev_ins(insn.ea, M65816_php);
+		// The PHP this pulls, paired up through the function's blocks
+		// (see php_matcher_t). Until the function exists, the nearest
+		// PHP above will do.
+		ea_t ea;
+		if (!phpmatch.find(insn.ea, &ea))
+			ea = backtrack_prev_ins(insn.ea, M65816_php);
 		if (ea != BADADDR)
 		{
-			xfer_sregs_short(ea, insn.ea + insn.size);
+			split_sreg(insn.ea + insn.size, rP, get_pstate(ea) | PS_ORG_INSN);
 			/*		uint16 p = get_cpu_status(ea);
 					split_sreg_range(insn.ea + insn.size, rFm, (p >> 5) & 0x1, SR_auto);
 					split_sreg_range(insn.ea + insn.size, rFx, (p >> 4) & 0x1, SR_auto);
@@ -360,27 +377,24 @@ int m65816_t::emu(const insn_t& insn)
 	}
 	break;
 
-	//case M65816_bcc:
-	//case M65816_bcs:
-	//case M65816_beq:
-	//case M65816_bmi:
-	//case M65816_bne:
-	//case M65816_bpl:
-	//case M65816_bra:
-	//case M65816_bvc:
-	//case M65816_bvs:
-	//case M65816_brl:
-
-	//	{
-	//		ea_t ftea = map_code_ea(insn, insn.Op1);
-
-	//		split_sreg_range(ftea, rFm, get_sreg(insn.ea, rFm), SR_auto);
-	//		split_sreg_range(ftea, rFx, get_sreg(insn.ea, rFx), SR_auto);
-	//	}
-
-	//	break;
+	case M65816_bcc:
+	case M65816_bcs:
+	case M65816_beq:
+	case M65816_bmi:
+	case M65816_bne:
+	case M65816_bpl:
+	case M65816_bra:
+	case M65816_bvc:
+	case M65816_bvs:
+	case M65816_brl:
+		// Branches keep M, X and E. This used to be done by ana(),
+		// which meant every decode wrote to the database.
+		xfer_sregs_short(insn, map_code_ea(insn, insn.Op1));
+		break;
 	}
 
+	// Segment register changes made above only reach the database here
+	flush_sregs();
 	return 1;
 }
 
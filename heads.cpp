@@ -0,0 +1,292 @@
+#include "m65816.hpp"
+
+// ---------------------------------------------------------------------------
+static int popcount64(uint64 w)
+{
+	w = w - ((w >> 1) & 0x5555555555555555ULL);
+	w = (w & 0x3333333333333333ULL) + ((w >> 2) & 0x3333333333333333ULL);
+	w = (w + (w >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+	return int((w * 0x0101010101010101ULL) >> 56);
+}
+
+// ---------------------------------------------------------------------------
+// Highest set bit of a non-zero word
+static int highbit64(uint64 w)
+{
+	int n = 0;
+	if (w >> 32) { w >>= 32; n += 32; }
+	if (w >> 16) { w >>= 16; n += 16; }
+	if (w >> 8) { w >>= 8; n += 8; }
+	if (w >> 4) { w >>= 4; n += 4; }
+	if (w >> 2) { w >>= 2; n += 2; }
+	if (w >> 1) { n += 1; }
+	return n;
+}
+
+// ---------------------------------------------------------------------------
+// Lowest set bit of a non-zero word
+static int lowbit64(uint64 w)
+{
+	return highbit64(w & (~w + 1));
+}
+
+// ---------------------------------------------------------------------------
+static bool test_bit(const uint64* bits, uint32 off)
+{
+	return (bits[off >> 6] >> (off & 63)) & 1;
+}
+
+// ---------------------------------------------------------------------------
+static void put_bit(uint64* bits, uint32 off, bool on)
+{
+	if (on)
+		bits[off >> 6] |= uint64(1) << (off & 63);
+	else
+		bits[off >> 6] &= ~(uint64(1) << (off & 63));
+}
+
+// ---------------------------------------------------------------------------
+// Highest set bit in [lo, hi), or -1
+static int find_prev_bit(const uint64* bits, uint32 lo, uint32 hi)
+{
+	if (lo >= hi)
+		return -1;
+	for (int32 w = int32((hi - 1) >> 6); w >= int32(lo >> 6); w--)
+	{
+		uint64 word = bits[w];
+		uint32 base = uint32(w) << 6;
+		if (hi - base < 64)
+			word &= (uint64(1) << (hi - base)) - 1;
+		if (lo > base)
+			word &= ~((uint64(1) << (lo - base)) - 1);
+		if (word != 0)
+			return int(base + highbit64(word));
+	}
+	return -1;
+}
+
+// ---------------------------------------------------------------------------
+// Lowest set bit in [lo, hi), or -1
+static int find_next_bit(const uint64* bits, uint32 lo, uint32 hi)
+{
+	if (lo >= hi)
+		return -1;
+	for (uint32 w = lo >> 6; w <= (hi - 1) >> 6; w++)
+	{
+		uint64 word = bits[w];
+		uint32 base = w << 6;
+		if (hi - base < 64)
+			word &= (uint64(1) << (hi - base)) - 1;
+		if (lo > base)
+			word &= ~((uint64(1) << (lo - base)) - 1);
+		if (word != 0)
+			return int(base + lowbit64(word));
+	}
+	return -1;
+}
+
+// ---------------------------------------------------------------------------
+head_index_t::bank_t* head_index_t::find_bank(ea_t ea)
+{
+	std::map<ea_t, std::unique_ptr<bank_t> >::iterator it = banks.find(ea >> BANK_BITS);
+	return it == banks.end() ? nullptr : it->second.get();
+}
+
+// ---------------------------------------------------------------------------
+head_index_t::bank_t* head_index_t::get_bank(ea_t ea)
+{
+	bank_t* b = find_bank(ea);
+	if (b != nullptr)
+		return b;
+
+	loads++;
+	b = new bank_t();
+	banks[ea >> BANK_BITS].reset(b);
+	b->rank_dirty = true;
+
+	ea_t start = ea & ~ea_t(BANK_SIZE - 1);
+	ea_t end = start + BANK_SIZE;
+	ea_t cur = start;
+	if (!::is_head(get_flags(cur)))
+		cur = next_head(cur, end);
+	for (; cur != BADADDR && cur < end; cur = next_head(cur, end))
+	{
+		flags64_t F = get_flags(cur);
+		uint32 off = uint32(cur - start);
+		put_bit(b->heads, off, true);
+		if (::is_code(F))
+			put_bit(b->code, off, true);
+		if (::is_func(F))
+			put_bit(b->funcs, off, true);
+	}
+	return b;
+}
+
+// ---------------------------------------------------------------------------
+void head_index_t::update_rank(bank_t* b)
+{
+	if (!b->rank_dirty)
+		return;
+	b->rank[0] = 0;
+	for (int w = 0; w < WORDS; w++)
+		b->rank[w + 1] = b->rank[w] + popcount64(b->code[w]);
+	b->rank_dirty = false;
+}
+
+// ---------------------------------------------------------------------------
+bool head_index_t::is_head(ea_t ea)
+{
+	return test_bit(get_bank(ea)->heads, uint32(ea & (BANK_SIZE - 1)));
+}
+
+// ---------------------------------------------------------------------------
+bool head_index_t::is_code(ea_t ea)
+{
+	return test_bit(get_bank(ea)->code, uint32(ea & (BANK_SIZE - 1)));
+}
+
+// ---------------------------------------------------------------------------
+bool head_index_t::is_func_start(ea_t ea)
+{
+	return test_bit(get_bank(ea)->funcs, uint32(ea & (BANK_SIZE - 1)));
+}
+
+// ---------------------------------------------------------------------------
+ea_t head_index_t::prev(ea_t ea, ea_t minea)
+{
+	while (ea > minea && ea != 0)
+	{
+		ea_t start = (ea - 1) & ~ea_t(BANK_SIZE - 1);
+		bank_t* b = get_bank(start);
+		uint32 lo = minea > start ? uint32(minea - start) : 0;
+		int bit = find_prev_bit(b->heads, lo, uint32(ea - start));
+		if (bit >= 0)
+			return start + bit;
+		ea = start;
+	}
+	return BADADDR;
+}
+
+// ---------------------------------------------------------------------------
+ea_t head_index_t::next(ea_t ea, ea_t maxea)
+{
+	ea_t cur = ea + 1;
+	while (cur < maxea && cur != 0)
+	{
+		ea_t start = cur & ~ea_t(BANK_SIZE - 1);
+		bank_t* b = get_bank(start);
+		uint32 hi = maxea - start < BANK_SIZE ? uint32(maxea - start) : BANK_SIZE;
+		int bit = find_next_bit(b->heads, uint32(cur - start), hi);
+		if (bit >= 0)
+			return start + bit;
+		cur = start + BANK_SIZE;
+	}
+	return BADADDR;
+}
+
+// ---------------------------------------------------------------------------
+uint32 head_index_t::rank(ea_t ea)
+{
+	bank_t* b = get_bank(ea);
+	update_rank(b);
+	uint32 off = uint32(ea & (BANK_SIZE - 1));
+	uint64 word = b->code[off >> 6] & ((uint64(1) << (off & 63)) - 1);
+	return b->rank[off >> 6] + popcount64(word);
+}
+
+// ---------------------------------------------------------------------------
+ea_t head_index_t::select(ea_t bank_ea, uint32 k)
+{
+	bank_t* b = get_bank(bank_ea);
+	update_rank(b);
+	if (k >= b->rank[WORDS])
+		return BADADDR;
+
+	// Last word with fewer than k + 1 instructions before it
+	int lo = 0, hi = WORDS - 1;
+	while (lo < hi)
+	{
+		int mid = (lo + hi + 1) / 2;
+		if (b->rank[mid] <= k)
+			lo = mid;
+		else
+			hi = mid - 1;
+	}
+	uint64 word = b->code[lo];
+	for (uint32 i = b->rank[lo]; i < k; i++)
+		word &= word - 1;
+	return (bank_ea & ~ea_t(BANK_SIZE - 1)) + (uint32(lo) << 6) + lowbit64(word);
+}
+
+// ---------------------------------------------------------------------------
+ea_t head_index_t::prev_n(ea_t ea, uint32 n)
+{
+	if (ea == 0)
+		return BADADDR;
+	ea_t start = (ea - 1) & ~ea_t(BANK_SIZE - 1);
+	uint32 r;
+	if (ea - start == BANK_SIZE)
+	{
+		bank_t* b = get_bank(start);
+		update_rank(b);
+		r = b->rank[WORDS];
+	}
+	else
+	{
+		r = rank(ea);
+	}
+	if (r < n)
+		return BADADDR;
+	return select(start, r - n);
+}
+
+// ---------------------------------------------------------------------------
+void head_index_t::set_code(ea_t ea)
+{
+	bank_t* b = find_bank(ea);
+	if (b == nullptr)
+		return;
+	uint32 off = uint32(ea & (BANK_SIZE - 1));
+	put_bit(b->heads, off, true);
+	put_bit(b->code, off, true);
+	b->rank_dirty = true;
+}
+
+// ---------------------------------------------------------------------------
+void head_index_t::set_data(ea_t ea, asize_t len)
+{
+	del_items(ea, ea + len);
+	bank_t* b = find_bank(ea);
+	if (b != nullptr)
+		put_bit(b->heads, uint32(ea & (BANK_SIZE - 1)), true);
+}
+
+// ---------------------------------------------------------------------------
+void head_index_t::del_items(ea_t start_ea, ea_t end_ea)
+{
+	for (ea_t ea = start_ea; ea < end_ea; )
+	{
+		ea_t bank_end = (ea & ~ea_t(BANK_SIZE - 1)) + BANK_SIZE;
+		ea_t stop = qmin(end_ea, bank_end);
+		bank_t* b = find_bank(ea);
+		if (b != nullptr)
+		{
+			for (ea_t cur = ea; cur < stop; cur++)
+			{
+				uint32 off = uint32(cur & (BANK_SIZE - 1));
+				put_bit(b->heads, off, false);
+				put_bit(b->code, off, false);
+			}
+			b->rank_dirty = true;
+		}
+		ea = stop;
+	}
+}
+
+// ---------------------------------------------------------------------------
+void head_index_t::set_func_start(ea_t ea, bool on)
+{
+	bank_t* b = find_bank(ea);
+	if (b != nullptr)
+		put_bit(b->funcs, uint32(ea & (BANK_SIZE - 1)), on);
+}
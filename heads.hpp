@@ -0,0 +1,78 @@
+#ifndef __HEADS_HPP__
+#define __HEADS_HPP__
+
+#include <pro.h>
+#include <map>
+#include <memory>
+
+/**
+ * Bitmaps of the item heads, instructions and function starts, one
+ * bank at a time.
+ *
+ * Backtracking and the per-function passes step from one instruction
+ * to the next or previous one all the time, and each step through
+ * prev_head()/next_head() and get_flags() is a database query. Here,
+ * a bank is read from the database the first time it is used, and
+ * kept up to date from the IDB events. Rank/select over the
+ * instruction bits give "the Nth instruction before" directly.
+ */
+class head_index_t
+{
+public:
+	bool is_head(ea_t ea);
+	bool is_code(ea_t ea);       // An instruction starts at 'ea'
+	bool is_func_start(ea_t ea);
+
+	/**
+	 * Same as prev_head() and next_head(): the head in [minea, ea),
+	 * or in (ea, maxea). BADADDR if there is none.
+	 */
+	ea_t prev(ea_t ea, ea_t minea);
+	ea_t next(ea_t ea, ea_t maxea);
+
+	/**
+	 * Instructions in the bank of 'ea', before 'ea'.
+	 */
+	uint32 rank(ea_t ea);
+
+	/**
+	 * The instruction of index 'k' in the bank starting at 'bank_ea',
+	 * or BADADDR.
+	 */
+	ea_t select(ea_t bank_ea, uint32 k);
+
+	/**
+	 * The 'n'th instruction before 'ea', in the same bank as the
+	 * byte before 'ea'. BADADDR if there are not that many.
+	 */
+	ea_t prev_n(ea_t ea, uint32 n);
+
+	// Updates, from the IDB events
+	void set_code(ea_t ea);
+	void set_data(ea_t ea, asize_t len);
+	void del_items(ea_t start_ea, ea_t end_ea);
+	void set_func_start(ea_t ea, bool on);
+	void clear() { banks.clear(); }
+
+	uint32 loads = 0; // Banks read from the database
+
+private:
+	enum { BANK_BITS = 16, BANK_SIZE = 1 << BANK_BITS, WORDS = BANK_SIZE / 64 };
+
+	struct bank_t
+	{
+		uint64 heads[WORDS];      // Item heads
+		uint64 code[WORDS];       // Heads that are instructions
+		uint64 funcs[WORDS];      // Function starts
+		uint32 rank[WORDS + 1];   // Instructions before each word of 'code'
+		bool rank_dirty;
+	};
+
+	std::map<ea_t, std::unique_ptr<bank_t> > banks; // By bank number
+
+	bank_t* get_bank(ea_t ea);
+	bank_t* find_bank(ea_t ea); // Only if loaded
+	void update_rank(bank_t* b);
+};
+
+#endif
@@ -1,38 +0,0 @@
-#pragma once
-
-
-static const long cop_len[][2] = {
-	{0x03, 1},
-	{0x04, 0},
-	{0x07, 4}, //ww
-	{0x08, 4}, //ww
-	{0x0C, 4}, //bbw
-	{0x10, 7}, //wbww
-	{0x11, 3}, //bbb
-	{0x12, 3}, //bw
-	{0x1B, 4}, //ww
-	{0x1F, 0},
-	{0x26, 4}, //ww
-	{0x27, 2}, //w
-	{0x34, 0},
-	{0x80, 1},
-	{0x81, 2}, //bb
-	{0x82, 0},
-	{0x83, 0},
-	{0x84, 3}, //wb
-	{0x85, 3}, //wb
-	{0x86, 0},
-	{0x91, 0},
-	{0x92, 1},
-	{0x94, 0},
-	{0x96, 0},
-	{0x98, 0},
-	{0xA0, 2},
-	{0xA2, 1},
-	{0xA3, 0},
-	{0xA8, 3}, //wb
-	{0xA9, 3}, //wb
-	{0xAC, 9}, //wbwww
-	{0xB0, 5}, //wbw
-	{0xB2, 9}  //wbwww
-};
\ No newline at end of file
@@ -9,7 +9,7 @@ struct cop_def {
 };
 
 
-static const struct cop_def cop_lst[0x100] = {
+static constexpr struct cop_def cop_lst[0x100] = {
 	{ 0x00 },
 	{ 0x01, 4, "Ob" },
 	{ 0x02, 4, "Ob" },
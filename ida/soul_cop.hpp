@@ -1,76 +0,0 @@
-#pragma once
-
-
-static const long cop_len[][2] = {
-	{0x01, 2}, //w
-	{0x03, 1}, //b
-	{0x04, 0},
-	{0x05, 2}, //w
-	{0x07, 4}, //ww
-	{0x08, 4}, //ww
-	{0x09, 2}, //w
-	{0x0B, 1}, //b
-	{0x0C, 4}, //bbw
-	{0x0D, 4}, //bbbw
-	{0x10, 7}, //wbww
-	{0x11, 3}, //bbb
-	{0x12, 3}, //bw
-	{0x14, 4}, //ww
-	{0x15, 0},
-	{0x16, 0},
-	{0x18, 3}, //bw
-	{0x19, 3}, //bw
-	{0x1B, 4}, //ww
-	{0x1C, 4}, //ww
-	{0x1F, 0},
-	{0x21, 2}, //w
-	{0x22, 2}, //w
-	{0x23, 2}, //w
-	{0x24, 2}, //w
-	{0x26, 4}, //ww
-	{0x27, 2}, //w
-	{0x30, 5}, //wwb
-	{0x31, 1}, //b
-	{0x34, 0},
-	{0x35, 1}, //b
-	{0x37, 0},
-	{0x3A, 0},
-	{0x80, 1}, //b
-	{0x81, 2}, //bb
-	{0x82, 0},
-	{0x83, 0},
-	{0x84, 3}, //wb
-	{0x85, 3}, //wb
-	{0x86, 0},
-	{0x87, 0},
-	{0x88, 0},
-	{0x8F, 0},
-	{0x90, 0},
-	{0x91, 0},
-	{0x92, 1}, //b
-	{0x94, 0},
-	{0x96, 0},
-	{0x97, 0},
-	{0x98, 0},
-	{0x99, 0},
-	{0x9A, 8}, //wwww
-	{0x9B, 8}, //wwww
-	{0x9C, 4}, //ww
-	{0x9D, 1}, //b
-	{0x9E, 2}, //w
-	{0x9F, 2}, //w
-	{0xA0, 2},
-	{0xA1, 4}, //ww
-	{0xA2, 1}, //b
-	{0xA3, 0},
-	{0xA4, 0},
-	{0xA5, 8}, //wwww
-	{0xA8, 3}, //wb
-	{0xA9, 3}, //wb
-	{0xAC, 9}, //wbwww
-	{0xAD, 1}, //b
-	{0xAE, 6}, //www
-	{0xAF, 5}, //wbw
-	{0xB0, 5}, //wbw
-	{0xB2, 9}  //wbwww
-};
\ No newline at end of file
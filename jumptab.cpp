@@ -0,0 +1,231 @@
+#include "m65816.hpp"
+
+// Register X is computed from, at some point above the jump
+enum jt_reg_t
+{
+	JR_A,
+	JR_X,
+	JR_Y
+};
+
+// ---------------------------------------------------------------------------
+static bool jt_decode(ea_t ea, m65_decoded_t* out)
+{
+	uint8 bytes[M65_MAX_INSN_SIZE];
+	ssize_t len = get_bytes(bytes, sizeof(bytes), ea);
+	return len > 0
+		&& decode_bytes(bytes, size_t(len), uint32(ea), get_cpu_mode(ea).mode, out) != 0;
+}
+
+// ---------------------------------------------------------------------------
+// The only instruction leading to 'ea', or BADADDR if there are several,
+// or if 'ea' is called
+static ea_t jt_pred(ea_t ea)
+{
+	ea_t pred = BADADDR;
+	xrefblk_t xb;
+	for (bool ok = xb.first_to(ea, XREF_ALL); ok; ok = xb.next_to())
+	{
+		if (!xb.iscode)
+			continue;
+		if (xb.type == fl_CF || xb.type == fl_CN || pred != BADADDR)
+			return BADADDR;
+		pred = xb.from;
+	}
+	if (pred != BADADDR && !get_head_index().is_code(pred))
+		return BADADDR;
+	return pred;
+}
+
+// ---------------------------------------------------------------------------
+// Whether 'insn' changes 'reg' in a way that isn't followed
+static bool jt_clobbers(const m65_decoded_t& insn, int reg)
+{
+	switch (insn.itype)
+	{
+	case M65816_jsr:
+	case M65816_jsl:
+	case M65816_cop:
+	case M65816_brk:
+	case M65816_mvn:
+	case M65816_mvp:
+		return true;
+
+	case M65816_lda:
+	case M65816_pla:
+	case M65816_txa:
+	case M65816_tya:
+	case M65816_tdc:
+	case M65816_tsc:
+	case M65816_xba:
+	case M65816_adc:
+	case M65816_sbc:
+	case M65816_and:
+	case M65816_ora:
+	case M65816_eor:
+		return reg == JR_A;
+
+	case M65816_asl:
+	case M65816_lsr:
+	case M65816_rol:
+	case M65816_ror:
+	case M65816_inc:
+	case M65816_dec:
+		return reg == JR_A && insn.addr == ACC;
+
+	case M65816_ldx:
+	case M65816_plx:
+	case M65816_tax:
+	case M65816_tsx:
+	case M65816_tyx:
+	case M65816_inx:
+	case M65816_dex:
+		return reg == JR_X;
+
+	case M65816_ldy:
+	case M65816_ply:
+	case M65816_tay:
+	case M65816_txy:
+	case M65816_iny:
+	case M65816_dey:
+		return reg == JR_Y;
+	}
+	return false;
+}
+
+// ---------------------------------------------------------------------------
+// Register a compare instruction tests, or -1
+static int jt_compared_reg(const m65_decoded_t& insn)
+{
+	if (insn.addr != IMM)
+		return -1;
+	switch (insn.itype)
+	{
+	case M65816_cmp: return JR_A;
+	case M65816_cpx: return JR_X;
+	case M65816_cpy: return JR_Y;
+	}
+	return -1;
+}
+
+// ---------------------------------------------------------------------------
+bool jt_find_bound(ea_t ea, jt_bound_t* out)
+{
+	// X at the jump is scale * reg + offset, reg being
+	// the value of 'reg' where the walk is
+	int reg = JR_X;
+	int64 scale = 1;
+	int64 offset = 0;
+	int64 max = is_xy_16_bits(ea) ? 0xFFFF : 0xFF;
+
+	ea_t cur = ea;
+	for (int n = 0; n < JT_MAX_WALK; n++)
+	{
+		ea_t p = jt_pred(cur);
+		m65_decoded_t insn;
+		if (p == BADADDR || !jt_decode(p, &insn))
+			return false;
+		bool taken = p + insn.size != cur;
+
+		bool bounded = false;
+		int64 lo = 0, hi = 0;
+		ea_t guard = p;
+		switch (insn.itype)
+		{
+		// On the path where the carry is clear, the register
+		// was below what it was compared with
+		case M65816_bcc:
+		case M65816_bcs:
+		{
+			if ((insn.itype == M65816_bcc) != taken)
+				break;
+			m65_decoded_t cmp;
+			guard = jt_pred(p);
+			if (guard != BADADDR && jt_decode(guard, &cmp)
+				&& jt_compared_reg(cmp) == reg && cmp.operand != 0)
+			{
+				bounded = true;
+				hi = cmp.operand - 1;
+			}
+		}
+		break;
+
+		case M65816_and:
+			if (reg != JR_A)
+				break;
+			if (insn.addr != IMM)
+				return false;
+			bounded = true;
+			hi = insn.operand;
+			break;
+
+		case M65816_lda:
+		case M65816_ldx:
+		case M65816_ldy:
+			if (jt_clobbers(insn, reg))
+			{
+				if (insn.addr != IMM)
+					return false;
+				bounded = true;
+				lo = hi = insn.operand;
+			}
+			break;
+
+		case M65816_tax: if (reg == JR_X) reg = JR_A; break;
+		case M65816_tay: if (reg == JR_Y) reg = JR_A; break;
+		case M65816_txa: if (reg == JR_A) reg = JR_X; break;
+		case M65816_tya: if (reg == JR_A) reg = JR_Y; break;
+		case M65816_txy: if (reg == JR_Y) reg = JR_X; break;
+		case M65816_tyx: if (reg == JR_X) reg = JR_Y; break;
+
+		case M65816_asl:
+			if (reg != JR_A)
+				break;
+			if (insn.addr != ACC)
+				return false;
+			scale *= 2;
+			break;
+
+		case M65816_inc:
+		case M65816_dec:
+			if (reg != JR_A)
+				break;
+			if (insn.addr != ACC)
+				return false;
+			offset += insn.itype == M65816_inc ? scale : -scale;
+			break;
+
+		case M65816_inx:
+		case M65816_iny:
+			if (jt_clobbers(insn, reg))
+				offset += scale;
+			break;
+
+		case M65816_dex:
+		case M65816_dey:
+			if (jt_clobbers(insn, reg))
+				offset -= scale;
+			break;
+
+		default:
+			if (jt_clobbers(insn, reg))
+				return false;
+			break;
+		}
+
+		if (bounded)
+		{
+			lo = scale * lo + offset;
+			hi = scale * hi + offset;
+			if (lo < 0 || hi > max || hi < lo)
+				return false;
+			out->lo = uint32(lo);
+			out->hi = uint32(hi);
+			out->step = uint32(qmax<int64>(scale, 2));
+			out->guard = guard;
+			return jt_entry_count(*out) <= JT_MAX_ENTRIES;
+		}
+		cur = p;
+	}
+	return false;
+}
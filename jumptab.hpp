@@ -0,0 +1,62 @@
+#ifndef __JUMPTAB_HPP__
+#define __JUMPTAB_HPP__
+
+#include <pro.h>
+
+// Size of JMP (abs,X) and JSR (abs,X) tables, from the code that
+// computes X.
+//
+// Without it, a table is read one word at a time until an entry looks
+// wrong, which tends to run past the end of the table into whatever
+// follows. Dispatchers almost always bound the index first:
+//
+//   .05:8000    CMP #$0C
+//   .05:8002    BCS $8009
+//   .05:8004    ASL A
+//   .05:8005    TAX
+//   .05:8006    JMP ($800A,X)
+//
+// Walking up from the jump, the register X comes from is tracked along
+// with how it was scaled and offset (X = 2*A here), until something
+// bounds it: a compare and a carry branch on the path taken, an AND,
+// or an immediate load. The bound then gives the range of X.
+
+// Instructions looked at before giving up
+#define JT_MAX_WALK 32
+
+// Largest table accepted
+#define JT_MAX_ENTRIES 256
+
+struct jt_bound_t
+{
+	uint32 lo;    // Lowest and highest value of X at the jump
+	uint32 hi;
+	uint32 step;  // Distance between the values of X
+	ea_t guard;   // What bounds X: the compare, AND or load
+};
+
+struct jt_stats_t
+{
+	uint32 bounded = 0;   // Tables whose size was found
+	uint32 unbounded = 0; // Tables read until an entry looked wrong
+	uint32 rejected = 0;  // Bounded tables with an invalid entry
+	uint32 entries = 0;   // Entries created
+};
+
+/**
+ * Find the range of X at the indexed indirect jump or call at 'ea'.
+ *
+ * returns : false if nothing bounds it, within JT_MAX_WALK instructions
+ *           of straight-line code.
+ */
+bool jt_find_bound(ea_t ea, jt_bound_t* out);
+
+/**
+ * Number of entries of the table, for a bound found by jt_find_bound().
+ */
+inline uint32 jt_entry_count(const jt_bound_t& b)
+{
+	return (b.hi - b.lo) / b.step + 1;
+}
+
+#endif
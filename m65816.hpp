@@ -5,7 +5,22 @@
 #include "../../module/idaidp.hpp"
 #include <segregs.hpp>
 #include "ins.hpp"
+#include "decode.hpp"
+#include "bt.hpp"
+#include "sreg.hpp"
+#include "mxflow.hpp"
+#include "summary.hpp"
+#include "callgraph.hpp"
+#include "phpmatch.hpp"
+#include "heads.hpp"
+#include "constprop.hpp"
+#include "jumptab.hpp"
+#include "copdialect.hpp"
+#include "xlat.hpp"
 #include "../iohandler.hpp"
+#include "portcache.hpp"
+#include "cartcache.hpp"
+#include "strucref.hpp"
 #define PROCMOD_NAME            m65816
 #define PROCMOD_NODE_NAME       "$ " QSTRINGIZE(PROCMOD_NAME)
 
@@ -37,111 +52,6 @@
 #define UAS_NOENS       0x0200          // don't specify start addr in the .end directive
 
 
-enum M65816_registers
-{
-	rA,   // Accumulator
-	rX,   // X index
-	rY,   // Y index
-	rS,   // Stack
-	rCs,  // code segment
-	rDs,  // data segment
-
-	// This will hold the value of B, the
-	// data bank register. We won't make use of Ds
-	// directly, as it is typically used, in computation,
-	// as a 16-byte paragraph register, while B is a
-	// 64KB pages register. Also, by having a dedicated
-	// B, the user will be able to modify it more
-	// easily (without having to manually shift the value by
-	// 12 bits).
-	// Note: Also, we won't have this register ``mapped'' to a sel_t.
-	// We'll stuff the B value in there directly, which allows
-	// it to be more versatile, and access banks where there's
-	// no ROM loaded (such as [S|W]RAM bank(s)).
-	rB,
-
-	// Direct page register. Same note as that of rB applies.
-	rD,
-
-	// These will be considered segment
-	// registers by IDA (just as rCs, rDs, rB and rD),
-	// but we'll actually use them to keep information
-	// about the 'm', 'x' and 'e' flags, determining
-	// what's the accumulator & indices mode, and whether
-	// we run in 6502 emulation or 65816 native mode.
-	rFm,
-	rFx,
-	rFe,
-
-	// program bank register
-	rPB,
-
-	rOm,
-	rOx
-};
-
-
-// Addressing modes
-enum m65_addrmode_t
-{
-	ABS = 0,
-	ABS_IX,
-	ABS_IY,
-	ABS_IX_INDIR,
-	ABS_INDIR,
-	ABS_INDIR_LONG,
-	ABS_LONG,
-	ABS_LONG_IX,
-	ACC,
-	BLK_MOV,
-	DP,
-	DP_IX,
-	DP_IY,
-	DP_IX_INDIR,
-	DP_INDIR,
-	DP_INDIR_LONG,
-	DP_INDIR_IY,
-	DP_INDIR_LONG_IY,
-	IMM,
-	IMPLIED,
-	PC_REL,
-	PC_REL_LONG,
-	STACK_ABS,
-	STACK_DP_INDIR,
-	STACK_INT,
-	STACK_PC_REL,
-	STACK_PULL,
-	STACK_PUSH,
-	STACK_RTI,
-	STACK_RTL,
-	STACK_RTS,
-	STACK_REL,
-	STACK_REL_INDIR_IY,
-	ADDRMODE_last
-};
-
-// The various phrases that can be used in case
-// an operand is of type 'o_displ'.
-enum odispl_phrases_t
-{
-	rDX = 100, // "dp, X"              DP_IX
-	rDY,       // "dp, Y"              DP_IY
-	riDX,      // "(dp, X)"            DP_IX_INDIR
-	rAbsi,     // "(abs)"              ABS_INDIR
-	rAbsiL,    // "long(abs)"          ABS_INDIR_LONG
-	rAbsX,     // "abs, X"             ABS_IX
-	rAbsY,     // "abs, Y"             ABS_IY
-	rAbsLX,    // "long abs, X"        ABS_LONG_IX
-	rAbsXi,    // "(abs,X)"            ABS_IX_INDIR
-	rDi,       // "(dp,n)"             DP_INDIR
-	rDiL,      // "long(dp,n)"         DP_INDIR_LONG
-	rDiY,      // "(dp,n), Y"          DP_INDIR_IY
-	rDiLY,     // "long(dp,n), Y"      DP_INDIR_LONG_IY
-	rSiY,      // (s,n),Y              STACK_REL_INDIR_IY
-	rSDi       // "(dp,n)"             STACK_DP_INDIR
-};
-
-
 // Information about addressing modes.
 struct addrmode_info_t
 {
@@ -151,72 +61,74 @@ struct addrmode_info_t
 extern const struct addrmode_info_t AddressingModes[];
 
 
-// The type of m65* processors. Used
-// to declare availability of certain opcodes depending
-// on the processor.
-enum m65_variant_t
+// Layout of the rP segment register. M and X sit at their
+// position in the P register, so SEP/REP operands apply as is.
+enum pstate_bits_t
 {
-	M6502 = 1,
-	M65C02 = 2,
-	M65802 = 4,
-	M65816 = 8,
-	M6X = 1 | 2 | 4 | 8
+	PS_X = 0x0010,          // Index registers are 8 bits
+	PS_M = 0x0020,          // Accumulator is 8 bits
+	PS_E = 0x0100,          // 6502 emulation mode
+	PS_FLAGS = PS_X | PS_M | PS_E,
+
+	// Origin of the value
+	PS_ORG_DEFAULT = 0x0000, // Segment default
+	PS_ORG_INSN = 0x1000,    // Set by SEP/REP/XCE/PLP
+	PS_ORG_FLOW = 0x2000,    // Propagated along a jump, branch or call
+	PS_ORG_USER = 0x3000,    // Set through one of the old m/x/e registers
+	PS_ORG_MASK = 0x3000
 };
 
-
-// Special flags, for certain opcodes
-enum opcode_flags_t
+// Registers superseded by rP
+inline bool is_legacy_flag_sreg(int reg)
 {
-	// Increment instruction's byte count
-	// if accumulator is in 16-bits mode.
-	ACC16_INCBC = 1,
+	return reg == rFm || reg == rFx || reg == rFe || reg == rOm || reg == rOx;
+}
 
-	// Increment instruction's byte count
-	// if X/Y registers are in 16-bits mode.
-	XY16_INCBC = 2
-};
+// Segment register access during analysis, through
+// m65816_t::sregs (see sreg_shadow_t).
+sel_t read_sreg(ea_t ea, int rg);
+bool read_sreg_range(sreg_range_t* out, ea_t ea, int rg);
+void split_sreg(ea_t ea, int rg, sel_t val);
+void flush_sregs();
 
-// Information about an opcode
-struct opcode_info_t
-{
-	m65_itype_t    itype;
-	m65_addrmode_t addr;
-	uint8          cpu_variants; // OR'd m65_variant_t
-	uint16         flags;        // OR'd opcode_flags_t
-};
+const func_summary_t& get_func_summary(func_t* pfn);
+head_index_t& get_head_index();
+const cop_desc_t& get_cop_desc(uint8 sig);
 
+// Flag bits of the rP value at 'ea'
+inline sel_t get_pstate(ea_t ea)
+{
+	sel_t p = read_sreg(ea, rP);
+	return p == BADSEL ? 0 : p & PS_FLAGS;
+}
 
-static bool get_logical_flags(ea_t ea, int rg) {
-	sreg_range_t range, other;
-	int org = rg == rFm ? rOm : rOx;
+inline m65_mode_t pstate_to_mode(sel_t p)
+{
+	return ((p & PS_M) ? M65_MODE_M : 0)
+		| ((p & PS_X) ? M65_MODE_X : 0)
+		| ((p & PS_E) ? M65_MODE_E : 0);
+}
 
-	bool has_range = get_sreg_range(&range, ea, rg);
-	bool has_other = get_sreg_range(&other, ea, org);
+// Processor state at an instruction, resolved from the
+// segment registers once and cached (see m65816_t::get_cpu_mode).
+struct cpu_mode_t
+{
+	m65_mode_t mode; // M65_MODE_M/X/E
+	sel_t db;        // Data bank (rB)
+	sel_t dp;        // Direct page (rD)
+	sel_t pb;        // Program bank (rPB)
 
-	if (has_range) {
-		if (has_other) {
-			if (other.start_ea > range.start_ea)
-				return other.val == 0;
-			if (range.start_ea > other.start_ea || range.val != other.val)
-				return range.val != 0;
-		}
-		else
-			return range.val != 0;
-	}
-	else if (has_other)
-		return other.val == 0;
+	bool acc_16() const { return mode_acc_16(mode); }
+	bool xy_16() const { return mode_xy_16(mode); }
+};
 
-	//Default
-	return false;
-}
+cpu_mode_t get_cpu_mode(ea_t ea);
 
-inline bool is_acc_16_bits(ea_t ea) { return !get_logical_flags(ea, rFm); }
-inline bool is_xy_16_bits(ea_t ea) { return !get_logical_flags(ea, rFx); }
+inline bool is_acc_16_bits(ea_t ea) { return get_cpu_mode(ea).acc_16(); }
+inline bool is_xy_16_bits(ea_t ea) { return get_cpu_mode(ea).xy_16(); }
 inline bool is_acc_16_bits(const insn_t& insn) { return is_acc_16_bits(insn.ea); }
 inline bool is_xy_16_bits(const insn_t& insn) { return is_xy_16_bits(insn.ea); }
 
-const struct opcode_info_t& get_opcode_info(uint8 opcode);
-
 // Determines whether an m65_itype_t is of type 'push'
 #define M65_ITYPE_PUSH(op) \
        (((op) == M65816_pea) \
@@ -261,6 +173,26 @@ struct m65816_iohandler_t : public iohandler_t
 
 DECLARE_PROC_LISTENER(idb_listener_t, struct m65816_t);
 
+// Small direct-mapped cache of resolved cpu_mode_t's. Entries are
+// tagged with a generation number, so that invalidating the whole
+// cache (whenever a segment register changes) is a single increment.
+#define CPU_MODE_CACHE_SIZE 512
+
+struct cpu_mode_cache_t
+{
+	struct entry_t
+	{
+		ea_t ea;
+		uint32 gen;
+		cpu_mode_t mode;
+	};
+
+	entry_t entries[CPU_MODE_CACHE_SIZE] = {};
+	uint32 gen = 1;
+
+	void invalidate() { gen++; }
+};
+
 struct m65816_t : public procmod_t
 {
 	netnode helper;
@@ -268,7 +200,24 @@ struct m65816_t : public procmod_t
 	idb_listener_t idb_listener = idb_listener_t(*this);
 	struct SuperFamicomCartridge* cartridge = nullptr;
 	snes_addr_t* sa = nullptr;
+	xlat_table_t xlt;
+	cart_cache_t cart;
 	bool flow = false;
+	cpu_mode_cache_t modes;
+	sreg_shadow_t sregs;
+	mx_flow_t mxflow;
+	func_summaries_t summaries = func_summaries_t(helper);
+	call_graph_t callgraph;
+	php_matcher_t phpmatch;
+	head_index_t heads;
+	const_facts_t consts;
+	jt_stats_t jtstats;
+	struc_refs_t strucrefs;
+	cop_dialects_t cops = cop_dialects_t(helper);
+	qstring cop_option; // M65816_COP_DIALECT, until there is a database
+	bt_cache_t btcache;
+	bt_stats_t btstats;
+	uint32 bt_budget = BT_DEFAULT_BUDGET;
 
 	m65816_t();
 	~m65816_t();
@@ -276,6 +225,7 @@ struct m65816_t : public procmod_t
 	virtual ssize_t idaapi on_event(ssize_t msgid, va_list va) override;
 
 	ea_t xlat(ea_t address);
+	cpu_mode_t get_cpu_mode(ea_t ea);
 
 	void handle_operand(const op_t& x, bool read_access, const insn_t& insn);
 	int ana(insn_t* _insn);
@@ -288,6 +238,7 @@ struct m65816_t : public procmod_t
 	void m65816_footer(outctx_t& ctx) const;
 
 	void load_from_idb();
+	void upgrade_pstate();
 };
 extern int data_id;
 
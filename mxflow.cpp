@@ -0,0 +1,551 @@
+#include <gdl.hpp>
+#include <algorithm>
+
+#include "m65816.hpp"
+
+static const struct
+{
+	int shift;
+	sel_t bit;
+} mx_flags[] =
+{
+	{ MXS_M_SHIFT, PS_M },
+	{ MXS_X_SHIFT, PS_X },
+	{ MXS_E_SHIFT, PS_E },
+};
+
+// ---------------------------------------------------------------------------
+static mx_flags_t mx_apply(mx_flags_t s, sel_t mask, mx_value_t v)
+{
+	for (const auto& f : mx_flags)
+		if (mask & f.bit)
+			s = (s & ~(3 << f.shift)) | (v << f.shift);
+	return s;
+}
+
+// ---------------------------------------------------------------------------
+static mx_flags_t mx_load(sel_t p)
+{
+	mx_flags_t s = 0;
+	for (const auto& f : mx_flags)
+		s |= ((p & f.bit) ? MXV_SET : MXV_CLEAR) << f.shift;
+	return s;
+}
+
+// ---------------------------------------------------------------------------
+static mx_reg_t mx_join(const mx_reg_t& a, const mx_reg_t& b)
+{
+	if (a.kind == MXR_NONE || a == b)
+		return b;
+	if (b.kind == MXR_NONE)
+		return a;
+	mx_reg_t r = { MXR_UNKNOWN, 0 };
+	return r;
+}
+
+// ---------------------------------------------------------------------------
+mx_state_t mx_join(const mx_state_t& a, const mx_state_t& b)
+{
+	mx_state_t s;
+	s.flags = a.flags | b.flags;
+	s.db = mx_join(a.db, b.db);
+	s.dp = mx_join(a.dp, b.dp);
+	return s;
+}
+
+// ---------------------------------------------------------------------------
+mx_state_t mx_entry_state(sel_t p)
+{
+	mx_state_t s;
+	s.flags = mx_load(p);
+	s.db.kind = MXR_ENTRY;
+	s.db.val = 0;
+	s.dp = s.db;
+	return s;
+}
+
+// ---------------------------------------------------------------------------
+mx_state_t mx_transfer(const mx_block_t& block, const mx_state_t& in, qvector<mx_state_t>* after)
+{
+	mx_state_t s = in;
+	qvector<mx_flags_t> stack;
+
+	if (after != nullptr)
+		after->clear();
+	for (const mx_effect_t& e : block.effects)
+	{
+		switch (e.kind)
+		{
+		case MXE_SET:
+			s.flags = mx_apply(s.flags, e.p, MXV_SET);
+			break;
+		case MXE_CLEAR:
+			s.flags = mx_apply(s.flags, e.p, MXV_CLEAR);
+			break;
+		case MXE_LOAD:
+			s.flags = mx_load(e.p);
+			break;
+		case MXE_PUSH:
+			stack.push_back(s.flags);
+			break;
+		case MXE_PULL:
+			if (stack.empty())
+				s.flags = mx_load(e.p);
+			else
+			{
+				s.flags = stack.back();
+				stack.pop_back();
+			}
+			break;
+		case MXE_DB:
+			s.db = e.reg;
+			break;
+		case MXE_DP:
+			s.dp = e.reg;
+			break;
+		case MXE_CALL:
+			s.flags = mx_apply(s.flags, e.p, MXV_SET);
+			s.flags = mx_apply(s.flags, e.clear, MXV_CLEAR);
+			if (e.db.kind == MXR_CONST || e.db.kind == MXR_UNKNOWN)
+				s.db = e.db;
+			if (e.dp.kind == MXR_CONST || e.dp.kind == MXR_UNKNOWN)
+				s.dp = e.dp;
+			break;
+		}
+		if (after != nullptr)
+			after->push_back(s);
+	}
+	return s;
+}
+
+// ---------------------------------------------------------------------------
+size_t mx_solve(qvector<mx_block_t>& blocks, int entry, const mx_state_t& entry_state, bool* converged)
+{
+	int n = int(blocks.size());
+
+	for (mx_block_t& block : blocks)
+	{
+		block.in = mx_state_t();
+		block.out = mx_state_t();
+		block.reached = false;
+	}
+
+	// Reverse postorder of the blocks reachable from 'entry'
+	intvec_t rpo;
+	intvec_t order(n, -1);
+	{
+		qvector<std::pair<int, int> > stack;
+		qvector<bool> seen(n, false);
+		stack.push_back(std::make_pair(entry, 0));
+		seen[entry] = true;
+		while (!stack.empty())
+		{
+			std::pair<int, int>& top = stack.back();
+			const intvec_t& succ = blocks[top.first].succ;
+			if (top.second < int(succ.size()))
+			{
+				int s = succ[top.second++];
+				if (!seen[s])
+				{
+					seen[s] = true;
+					stack.push_back(std::make_pair(s, 0));
+				}
+			}
+			else
+			{
+				rpo.push_back(top.first);
+				stack.pop_back();
+			}
+		}
+		std::reverse(rpo.begin(), rpo.end());
+		for (int i = 0; i < int(rpo.size()); i++)
+			order[rpo[i]] = i;
+	}
+
+	blocks[entry].in = entry_state;
+	blocks[entry].reached = true;
+
+	// Each block's input can only go up the lattice, by at most
+	// two steps for each of the three flags and for DB and D.
+	size_t visits = 0;
+	size_t limit = size_t(n) * 12;
+	qvector<bool> done(n, false);
+	std::set<int> work;
+	work.insert(order[entry]);
+	while (!work.empty() && visits < limit)
+	{
+		int b = rpo[*work.begin()];
+		work.erase(work.begin());
+		visits++;
+
+		mx_block_t& block = blocks[b];
+		mx_state_t out = mx_transfer(block, block.in);
+		if (done[b] && out == block.out)
+			continue;
+		done[b] = true;
+		block.out = out;
+
+		for (int s : block.succ)
+		{
+			mx_block_t& next = blocks[s];
+			mx_state_t in = mx_join(next.in, out);
+			if (!next.reached || in != next.in)
+			{
+				next.in = in;
+				next.reached = true;
+				work.insert(order[s]);
+			}
+		}
+	}
+	if (converged != nullptr)
+		*converged = work.empty();
+	return visits;
+}
+
+// ---------------------------------------------------------------------------
+void mx_set_call_effect(mx_effect_t& e, const func_summary_t& callee)
+{
+	// Same rule as for the flags: only M and X, and only
+	// those the callee changes
+	sel_t mask = func_summary_changes(callee) & (PS_M | PS_X);
+	e.p = callee.exit & mask;
+	e.clear = mask & ~callee.exit;
+	e.db.kind = callee.db_kind;
+	e.db.val = callee.exit_db;
+	e.dp.kind = callee.dp_kind;
+	e.dp.val = callee.exit_dp;
+}
+
+// ---------------------------------------------------------------------------
+bool mx_summarize(const qvector<mx_block_t>& blocks, func_summary_t* s)
+{
+	mx_state_t exit = {};
+	for (const mx_block_t& block : blocks)
+		if (block.reached && block.ret)
+			exit = mx_join(exit, block.out);
+	if (exit.flags == MXV_NONE)
+		return false;
+
+	s->flags |= FS_PASS;
+	s->exit = 0;
+	s->exit_mask = 0;
+	for (const auto& f : mx_flags)
+	{
+		mx_value_t v = mxs_get(exit.flags, f.shift);
+		if (v == MXV_SET || v == MXV_CLEAR)
+		{
+			s->exit_mask |= f.bit;
+			if (v == MXV_SET)
+				s->exit |= f.bit;
+		}
+	}
+	s->db_kind = exit.db.kind;
+	s->exit_db = exit.db.kind == MXR_CONST ? exit.db.val : 0;
+	s->dp_kind = exit.dp.kind;
+	s->exit_dp = exit.dp.kind == MXR_CONST ? exit.dp.val : 0;
+	return true;
+}
+
+// ---------------------------------------------------------------------------
+void mx_flow_t::mark(ea_t ea)
+{
+	func_t* pfn = get_func(ea);
+	if (pfn != nullptr)
+		dirty.insert(pfn->start_ea);
+}
+
+// ---------------------------------------------------------------------------
+void mx_flow_t::clear()
+{
+	dirty.clear();
+	passes.clear();
+}
+
+// ---------------------------------------------------------------------------
+void mx_flow_t::run()
+{
+	std::set<ea_t> todo;
+	todo.swap(dirty);
+	for (ea_t ea : todo)
+	{
+		func_t* pfn = get_func(ea);
+		if (pfn != nullptr && pfn->start_ea == ea)
+			run(pfn);
+	}
+}
+
+// ---------------------------------------------------------------------------
+bool mx_flow_t::run(func_t* pfn)
+{
+	uint8& count = passes[pfn->start_ea];
+	if (count >= MXFLOW_MAX_PASSES)
+		return false;
+
+	// The states call_graph_t solved, if they still hold
+	m65816_t& pm = *GET_MODULE_DATA(m65816_t);
+	sel_t p = get_pstate(pfn->start_ea);
+	qvector<mx_block_t> blocks;
+	const qvector<mx_block_t>* solved = pm.callgraph.solved(pfn->start_ea, p, pm.summaries);
+	if (solved != nullptr)
+	{
+		reused++;
+	}
+	else
+	{
+		int entry;
+		bool converged;
+		if (!mx_build(pfn, blocks, &entry))
+			return false;
+		visits += uint32(mx_solve(blocks, entry, mx_entry_state(p), &converged));
+		if (!converged)
+		{
+			// Leave the ranges as emu() set them
+			unsolved++;
+			return false;
+		}
+		solved = &blocks;
+	}
+	bool changed = commit(*solved);
+
+	// After the commit, which drops the function's summary
+	// if it changed any range
+	func_summary_t s = get_func_summary(pfn);
+	s.entry = uint16(p);
+	if (mx_summarize(*solved, &s))
+		pm.summaries.set(pfn->start_ea, s);
+
+	if (changed)
+		count++;
+	return changed;
+}
+
+// ---------------------------------------------------------------------------
+static mx_effect_t& add_effect(mx_block_t& block, ea_t ea, mx_effect_kind_t kind, sel_t p, bool user = false)
+{
+	mx_effect_t& e = block.effects.push_back();
+	memset(&e, 0, sizeof(e));
+	e.ea = ea;
+	e.kind = kind;
+	e.user = user;
+	e.p = p;
+	e.callee = -1;
+	return e;
+}
+
+// ---------------------------------------------------------------------------
+// What emu() found for DB or D after the instruction ending at 'next'
+static mx_reg_t reg_after(ea_t next, int rg)
+{
+	mx_reg_t r = { MXR_UNKNOWN, 0 };
+	sreg_range_t range;
+	if (read_sreg_range(&range, next, rg) && range.start_ea == next && range.val != BADSEL)
+	{
+		r.kind = MXR_CONST;
+		r.val = uint16(range.val);
+	}
+	return r;
+}
+
+// ---------------------------------------------------------------------------
+bool mx_build(func_t* pfn, qvector<mx_block_t>& blocks, int* entry)
+{
+	qflow_chart_t fc("", pfn, BADADDR, BADADDR, FC_NOEXT);
+	int n = fc.size();
+	if (n == 0)
+		return false;
+
+	head_index_t& heads = get_head_index();
+	*entry = -1;
+	blocks.resize(n);
+	for (int i = 0; i < n; i++)
+	{
+		mx_block_t& block = blocks[i];
+		block.start_ea = fc.blocks[i].start_ea;
+		block.end_ea = fc.blocks[i].end_ea;
+		if (block.start_ea == pfn->start_ea)
+			*entry = i;
+		block.ret = fc.is_ret_block(i);
+		for (int j = 0; j < fc.nsucc(i); j++)
+		{
+			int s = fc.succ(i, j);
+			if (s >= 0 && s < n)
+				block.succ.push_back(s);
+		}
+
+		insn_t insn;
+		for (ea_t ea = block.start_ea;
+			ea != BADADDR && ea < block.end_ea;
+			ea = heads.next(ea, block.end_ea))
+		{
+			if (!heads.is_code(ea) || decode_insn(&insn, ea) <= 0)
+				continue;
+
+			// Ranges set by the user are taken as they are. Any other
+			// range that starts inside the block gets overwritten with
+			// the computed state.
+			sreg_range_t range;
+			if (read_sreg_range(&range, ea, rP) && range.start_ea == ea)
+			{
+				if (range.tag == SR_user)
+					add_effect(block, ea, MXE_LOAD, range.val & PS_FLAGS, true);
+				else if (ea != block.start_ea
+					&& (block.effects.empty() || block.effects.back().ea != ea))
+					add_effect(block, ea, MXE_KEEP, 0);
+			}
+
+			ea_t next = ea + insn.size;
+			switch (insn.itype)
+			{
+			case M65816_sep:
+			case M65816_rep:
+			{
+				sel_t mask = insn.Op1.value & (PS_M | PS_X);
+				if (mask != 0)
+					add_effect(block, next, insn.itype == M65816_sep ? MXE_SET : MXE_CLEAR, mask);
+			}
+			break;
+
+			case M65816_xce:
+			{
+				uint16 prev = get_opcode_info(get_byte(ea - 1)).itype;
+				if (prev == M65816_clc)
+					add_effect(block, next, MXE_CLEAR, PS_E);
+				else if (prev == M65816_sec)
+					add_effect(block, next, MXE_SET, PS_E | PS_M | PS_X);
+			}
+			break;
+
+			case M65816_php:
+				add_effect(block, ea, MXE_PUSH, 0);
+				break;
+
+			case M65816_plp:
+				// What emu() found by backtracking, for when
+				// the PHP is not in this block
+				add_effect(block, next, MXE_PULL, get_pstate(next));
+				break;
+
+			case M65816_plb:
+				add_effect(block, next, MXE_DB, 0).reg = reg_after(next, rB);
+				break;
+
+			case M65816_pld:
+			case M65816_tcd:
+				add_effect(block, next, MXE_DP, 0).reg = reg_after(next, rD);
+				break;
+
+			case M65816_jsr:
+			case M65816_jsl:
+			{
+				func_t* callee = get_func(get_first_fcref_from(ea));
+				if (callee != nullptr)
+				{
+					mx_effect_t& e = add_effect(block, next, MXE_CALL, 0);
+					e.target = callee->start_ea;
+					mx_set_call_effect(e, get_func_summary(callee));
+				}
+				// Indirect call: keep what emu() has put after it
+				else if (read_sreg_range(&range, next, rP) && range.start_ea == next
+					&& range.tag != SR_user)
+					add_effect(block, next, MXE_LOAD, range.val & PS_FLAGS);
+			}
+			break;
+			}
+		}
+	}
+	return *entry != -1;
+}
+
+// ---------------------------------------------------------------------------
+// Writes the known flags of 's' at 'ea', keeping the current value of
+// the unknown ones. Ranges set by the user are left alone.
+static bool write_state(ea_t ea, mx_flags_t s, sel_t origin)
+{
+	sreg_range_t range;
+	if (read_sreg_range(&range, ea, rP) && range.start_ea == ea && range.tag == SR_user)
+		return false;
+
+	sel_t cur = get_pstate(ea);
+	sel_t p = cur;
+	for (const auto& f : mx_flags)
+	{
+		mx_value_t v = mxs_get(s, f.shift);
+		if (v == MXV_SET)
+			p |= f.bit;
+		else if (v == MXV_CLEAR)
+			p &= ~f.bit;
+	}
+	if (p == cur)
+		return false;
+
+	split_sreg(ea, rP, p | origin);
+	return true;
+}
+
+// ---------------------------------------------------------------------------
+// DB and D after a call to a function that sets them
+static bool write_regs(const mx_effect_t& call, const mx_state_t& s)
+{
+	bool changed = false;
+	if (call.db.kind == MXR_CONST && s.db.kind == MXR_CONST
+		&& read_sreg(call.ea, rB) != s.db.val)
+	{
+		split_sreg(call.ea, rB, s.db.val);
+		split_sreg(call.ea, rDs, sel_t(s.db.val) << 12);
+		changed = true;
+	}
+	if (call.dp.kind == MXR_CONST && s.dp.kind == MXR_CONST
+		&& read_sreg(call.ea, rD) != s.dp.val)
+	{
+		split_sreg(call.ea, rD, s.dp.val);
+		changed = true;
+	}
+	return changed;
+}
+
+// ---------------------------------------------------------------------------
+bool mx_flow_t::commit(const qvector<mx_block_t>& blocks)
+{
+	// The state at the start of a block is the join of its
+	// predecessors; the effect of the instruction just before
+	// it is only one of them.
+	std::set<ea_t> starts;
+	for (const mx_block_t& block : blocks)
+		if (block.reached)
+			starts.insert(block.start_ea);
+
+	bool changed = false;
+	qvector<mx_state_t> after;
+	for (const mx_block_t& block : blocks)
+	{
+		if (!block.reached)
+			continue;
+
+		bool block_changed = write_state(block.start_ea, block.in.flags, PS_ORG_FLOW);
+		mx_transfer(block, block.in, &after);
+		for (size_t i = 0; i < block.effects.size(); i++)
+		{
+			const mx_effect_t& e = block.effects[i];
+			if (e.kind == MXE_PUSH || e.user || starts.count(e.ea) != 0)
+				continue;
+			if (e.kind == MXE_DB || e.kind == MXE_DP)
+				continue; // Already set by emu()
+			if (e.kind == MXE_CALL && write_regs(e, after[i]))
+				block_changed = true;
+			sel_t origin = (e.kind == MXE_SET || e.kind == MXE_CLEAR || e.kind == MXE_PULL)
+				? PS_ORG_INSN
+				: PS_ORG_FLOW;
+			if (write_state(e.ea, after[i].flags, origin))
+				block_changed = true;
+		}
+
+		// Instruction lengths depend on the flags
+		if (block_changed)
+		{
+			plan_range(block.start_ea, block.end_ea);
+			changed = true;
+		}
+	}
+	flush_sregs();
+	return changed;
+}
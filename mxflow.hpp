@@ -0,0 +1,201 @@
+#ifndef __MXFLOW_HPP__
+#define __MXFLOW_HPP__
+
+#include <pro.h>
+#include <funcs.hpp>
+#include <map>
+#include <set>
+#include "summary.hpp"
+
+// M/X/E dataflow over the basic blocks of a function.
+//
+// emu() sets the flags one instruction at a time, as IDA's auto-analysis
+// reaches them, and the last write to a given address wins. Where paths
+// with different flags meet (a branch around a REP, say), the result
+// depends on the order the instructions were analyzed in, and can keep
+// changing as they get reanalyzed.
+//
+// This pass computes the flags for a whole function at once, joining
+// them where paths meet, and writes the resulting ranges in one go.
+// DB and D are tracked along, so that the effect of a function on
+// them can be summarized for its callers (see call_graph_t).
+//
+// mx_transfer(), mx_solve() and mx_summarize() only work on the data
+// they are given, and are safe to call from any thread.
+
+
+// Value of one flag at a program point. Two bits, so that
+// joining two values is a bitwise OR.
+enum mx_value_t
+{
+	MXV_NONE = 0,   // Not reached yet
+	MXV_SET = 1,    // 8 bits (M, X), or emulation mode (E)
+	MXV_CLEAR = 2,  // 16 bits (M, X), or native mode (E)
+	MXV_UNKNOWN = 3 // Differs between paths
+};
+
+// M, X and E, as three mx_value_t
+typedef uint8 mx_flags_t;
+
+#define MXS_M_SHIFT 0
+#define MXS_X_SHIFT 2
+#define MXS_E_SHIFT 4
+
+inline mx_value_t mxs_get(mx_flags_t s, int shift) { return mx_value_t((s >> shift) & 3); }
+
+// Value of DB or D at a program point
+enum mx_reg_kind_t
+{
+	MXR_NONE = 0, // Not reached yet
+	MXR_ENTRY,    // Whatever it was on entry to the function
+	MXR_CONST,    // 'val'
+	MXR_UNKNOWN   // Changed to something unknown, or differs between paths
+};
+
+struct mx_reg_t
+{
+	uint8 kind;  // mx_reg_kind_t
+	uint16 val;
+};
+
+inline bool operator==(const mx_reg_t& a, const mx_reg_t& b)
+{
+	return a.kind == b.kind && (a.kind != MXR_CONST || a.val == b.val);
+}
+
+struct mx_state_t
+{
+	mx_flags_t flags;
+	mx_reg_t db;
+	mx_reg_t dp;
+};
+
+inline bool operator==(const mx_state_t& a, const mx_state_t& b)
+{
+	return a.flags == b.flags && a.db == b.db && a.dp == b.dp;
+}
+inline bool operator!=(const mx_state_t& a, const mx_state_t& b) { return !(a == b); }
+
+mx_state_t mx_join(const mx_state_t& a, const mx_state_t& b);
+
+// State on entry to a function whose flags are 'p'
+mx_state_t mx_entry_state(sel_t p);
+
+// What an instruction does to the state
+enum mx_effect_kind_t
+{
+	MXE_SET,   // SEP, SEC+XCE: set the flags in 'p'
+	MXE_CLEAR, // REP, CLC+XCE: clear the flags in 'p'
+	MXE_LOAD,  // The flags become 'p' (a user range, or the state after an indirect call)
+	MXE_PUSH,  // PHP
+	MXE_PULL,  // PLP: the last pushed state, or 'p' if the PHP is in another block
+	MXE_KEEP,  // No change, but a range starts here
+	MXE_DB,    // PLB: DB becomes 'reg'
+	MXE_DP,    // PLD, TCD: D becomes 'reg'
+	MXE_CALL   // JSR/JSL to 'target': see 'p', 'clear', 'db' and 'dp'
+};
+
+struct mx_effect_t
+{
+	ea_t ea;      // Where the new state applies from
+	uint8 kind;   // mx_effect_kind_t
+	bool user;    // MXE_LOAD of a range set by the user
+	sel_t p;      // PS_* flag bits; for MXE_CALL, the flags the callee sets
+	sel_t clear;  // MXE_CALL: flags the callee clears
+	mx_reg_t reg; // MXE_DB, MXE_DP
+	mx_reg_t db;  // MXE_CALL: DB on return (MXR_ENTRY: unchanged)
+	mx_reg_t dp;  // MXE_CALL: D on return
+	ea_t target;  // MXE_CALL: start of the callee
+	int callee;   // MXE_CALL: index of the callee, for call_graph_t
+};
+
+struct mx_block_t
+{
+	ea_t start_ea;
+	ea_t end_ea;
+	intvec_t succ;
+	qvector<mx_effect_t> effects;
+	mx_state_t in = {};
+	mx_state_t out = {};
+	bool reached = false;
+	bool ret = false; // Ends with a return
+};
+
+/**
+ * Apply a block's effects to the state 'in'.
+ *
+ * after : If not null, receives the state following each effect.
+ *
+ * returns : The state at the end of the block.
+ */
+mx_state_t mx_transfer(const mx_block_t& block, const mx_state_t& in, qvector<mx_state_t>* after = nullptr);
+
+/**
+ * Worklist fixpoint over 'blocks', in reverse postorder from 'entry'.
+ *
+ * converged : If not null, receives false if the visit limit was hit
+ *             first, in which case the states are partial and must not
+ *             be written out or summarized.
+ *
+ * returns : The number of block visits it took.
+ */
+size_t mx_solve(qvector<mx_block_t>& blocks, int entry, const mx_state_t& entry_state, bool* converged = nullptr);
+
+/**
+ * Set the MXE_CALL effect 'e' from the callee's summary.
+ */
+void mx_set_call_effect(mx_effect_t& e, const func_summary_t& callee);
+
+/**
+ * Update the exit state of 's' from a solved function: the join of the
+ * states at the end of its return blocks.
+ *
+ * returns : false if no return block was reached.
+ */
+bool mx_summarize(const qvector<mx_block_t>& blocks, func_summary_t* s);
+
+/**
+ * Build the blocks of 'pfn' and their effects, from the database.
+ * Calls are set from the callees' current summaries.
+ */
+bool mx_build(func_t* pfn, qvector<mx_block_t>& blocks, int* entry);
+
+// Maximum number of times the pass runs on the same function in
+// a session, in case its results keep getting the code reanalyzed.
+#define MXFLOW_MAX_PASSES 3
+
+class mx_flow_t
+{
+public:
+	/**
+	 * Flag 'ea''s function as needing the pass, once
+	 * auto-analysis is done with it.
+	 */
+	void mark(ea_t ea);
+
+	/**
+	 * Run the pass on the marked functions.
+	 */
+	void run();
+
+	/**
+	 * Run the pass on one function.
+	 *
+	 * returns : true if any range was changed.
+	 */
+	bool run(func_t* pfn);
+
+	void clear();
+
+	uint32 visits = 0; // Block visits, over all runs
+	uint32 reused = 0; // Functions whose states came from call_graph_t
+	uint32 unsolved = 0; // Solves stopped by the visit limit
+
+private:
+	std::set<ea_t> dirty;
+	std::map<ea_t, uint8> passes;
+
+	bool commit(const qvector<mx_block_t>& blocks);
+};
+
+#endif
@@ -35,7 +35,7 @@ DECLARE_OUT_FUNCS_WITHOUT_OUTMNEM(out_m65816_t)
 //----------------------------------------------------------------------
 void out_m65816_t::out_dp(const op_t& x)
 {
-	sel_t dp = get_sreg(insn.ea, rD);
+	sel_t dp = pm().get_cpu_mode(insn.ea).dp;
 	if (dp != BADSEL)
 	{
 		ea_t orig_ea = dp + x.addr;
@@ -58,7 +58,7 @@ void out_m65816_t::out_dp(const op_t& x)
 //----------------------------------------------------------------------
 void out_m65816_t::out_addr_near_b(const op_t& x)
 {
-	sel_t db = get_sreg(insn.ea, rB);
+	sel_t db = pm().get_cpu_mode(insn.ea).db;
 	if (db != BADSEL)
 	{
 		ea_t orig_ea = (db << 16) + x.addr;
@@ -198,7 +198,7 @@ bool out_m65816_t::out_operand(const op_t& x)
 		}
 		else
 		{
-			sel_t db = get_sreg(insn.ea, rB);
+			sel_t db = pm().get_cpu_mode(insn.ea).db;
 			if (db == BADSEL)
 				ea = orig_ea = x.addr;
 			else
@@ -383,7 +383,7 @@ bool out_m65816_t::out_operand(const op_t& x)
 //----------------------------------------------------------------------
 static bool forced_print(flags64_t F, int reg)
 {
-	return (reg == rFm || reg == rFx) && is_func(F);
+	return reg == rP && is_func(F);
 }
 
 //----------------------------------------------------------------------
@@ -398,16 +398,22 @@ void m65816_t::m65816_assumes(outctx_t& ctx)
 	bool seg_started = (ea == seg->start_ea);
 	for (int reg = ph.reg_first_sreg; reg <= ph.reg_last_sreg; reg++)
 	{
-		if (reg == rCs)
+		// rCs is implied, and the flag registers other than
+		// rP are only there for older databases
+		if (reg == rCs || is_legacy_flag_sreg(reg))
 			continue;
 		sreg_range_t srrange;
 		if (!get_sreg_range(&srrange, ea, reg))
 			continue;
 		sel_t curval = srrange.val;
+		if (reg == rP)
+			curval &= PS_FLAGS;
 		if (seg_started || srrange.start_ea == ea)
 		{
 			sreg_range_t prev;
 			bool prev_exists = get_sreg_range(&prev, ea - 1, reg);
+			if (prev_exists && reg == rP)
+				prev.val &= PS_FLAGS;
 			if (seg_started
 				|| (prev_exists && prev.val != curval)
 				|| forced_print(ctx.F, reg))
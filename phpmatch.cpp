@@ -0,0 +1,134 @@
+#include <gdl.hpp>
+#include "m65816.hpp"
+
+// ---------------------------------------------------------------------------
+bool php_matcher_t::find(ea_t plp_ea, ea_t* php_ea)
+{
+	func_t* pfn = get_func(plp_ea);
+	if (pfn == nullptr)
+		return false;
+
+	lookups++;
+	std::map<ea_t, pairs_t>::iterator it = funcs.find(pfn->start_ea);
+	if (it == funcs.end())
+	{
+		it = funcs.insert(std::make_pair(pfn->start_ea, pairs_t())).first;
+		build(pfn, it->second);
+	}
+
+	pairs_t::const_iterator p = it->second.find(plp_ea);
+	*php_ea = p == it->second.end() ? BADADDR : p->second;
+	return true;
+}
+
+// ---------------------------------------------------------------------------
+void php_matcher_t::invalidate(ea_t ea)
+{
+	func_t* pfn = get_func(ea);
+	if (pfn != nullptr)
+		funcs.erase(pfn->start_ea);
+}
+
+// ---------------------------------------------------------------------------
+void php_matcher_t::invalidate(ea_t ea1, ea_t ea2)
+{
+	if (funcs.empty())
+		return;
+	func_t* chunk = get_fchunk(ea1);
+	if (chunk == nullptr)
+		chunk = get_next_fchunk(ea1);
+	while (chunk != nullptr && chunk->start_ea < ea2)
+	{
+		invalidate(chunk->start_ea);
+		chunk = get_next_fchunk(chunk->start_ea);
+	}
+}
+
+// ---------------------------------------------------------------------------
+void php_matcher_t::build(func_t* pfn, pairs_t& pairs)
+{
+	builds++;
+	qflow_chart_t fc("", pfn, BADADDR, BADADDR, FC_NOEXT);
+	int n = fc.size();
+
+	// PHPs not pulled yet on entry to each block. If paths with
+	// different stacks meet, what's under the block's own PHPs
+	// is unknown.
+	struct state_t
+	{
+		bool seen = false;
+		bool unknown = false;
+		eavec_t stack;
+	};
+	qvector<state_t> states;
+	states.resize(n);
+
+	head_index_t& heads = get_head_index();
+	intvec_t work;
+	for (int i = 0; i < n; i++)
+	{
+		if (fc.blocks[i].start_ea == pfn->start_ea)
+		{
+			states[i].seen = true;
+			work.push_back(i);
+		}
+	}
+
+	while (!work.empty())
+	{
+		int b = work.back();
+		work.pop_back();
+
+		eavec_t stack = states[b].stack;
+		bool unknown = states[b].unknown;
+		for (ea_t ea = fc.blocks[b].start_ea;
+			ea != BADADDR && ea < fc.blocks[b].end_ea;
+			ea = heads.next(ea, fc.blocks[b].end_ea))
+		{
+			if (!heads.is_code(ea))
+				continue;
+
+			uint16 itype = get_opcode_info(get_byte(ea)).itype;
+			if (itype == M65816_php)
+			{
+				stack.push_back(ea);
+			}
+			else if (itype == M65816_plp)
+			{
+				if (!stack.empty())
+				{
+					pairs[ea] = stack.back();
+					stack.pop_back();
+				}
+				else
+				{
+					pairs[ea] = BADADDR;
+				}
+			}
+		}
+
+		for (int j = 0; j < fc.nsucc(b); j++)
+		{
+			int s = fc.succ(b, j);
+			if (s < 0 || s >= n)
+				continue;
+
+			state_t& st = states[s];
+			if (!st.seen)
+			{
+				st.seen = true;
+				st.unknown = unknown;
+				st.stack = stack;
+				work.push_back(s);
+			}
+			else if (!st.unknown && (unknown || st.stack != stack))
+			{
+				// Taken again with an unknown stack; each block
+				// is walked twice at most
+				st.unknown = true;
+				st.stack.clear();
+				work.push_back(s);
+			}
+		}
+	}
+}
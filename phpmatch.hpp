@@ -0,0 +1,55 @@
+#ifndef __PHPMATCH_HPP__
+#define __PHPMATCH_HPP__
+
+#include <pro.h>
+#include <funcs.hpp>
+#include <map>
+
+/**
+ * Pairs each PLP of a function with the PHP it pulls.
+ *
+ * Taking the nearest PHP above a PLP goes wrong as soon as the pairs
+ * nest, or the PHP is on another path. Instead, the blocks of the
+ * function are walked once from its entry, keeping a stack of the
+ * PHPs not pulled yet. A PLP gets paired with the top of that stack,
+ * unless paths with different stacks lead to it.
+ *
+ * The pairs of a function are computed the first time one of its
+ * PLPs is looked up, and kept until the function changes.
+ */
+class php_matcher_t
+{
+public:
+	/**
+	 * Find the PHP that 'plp_ea' pulls.
+	 *
+	 * php_ea  : Receives the PHP, or BADADDR if there is none or
+	 *           paths disagree.
+	 *
+	 * returns : false if 'plp_ea' is not in a function yet.
+	 */
+	bool find(ea_t plp_ea, ea_t* php_ea);
+
+	/**
+	 * Forget the pairs of the function at 'ea'.
+	 */
+	void invalidate(ea_t ea);
+
+	/**
+	 * Forget the pairs of all functions with code in [ea1, ea2).
+	 */
+	void invalidate(ea_t ea1, ea_t ea2);
+	void clear() { funcs.clear(); }
+
+	uint32 lookups = 0;
+	uint32 builds = 0;
+
+private:
+	typedef std::map<ea_t, ea_t> pairs_t; // PLP -> PHP
+
+	std::map<ea_t, pairs_t> funcs; // By function start
+
+	void build(func_t* pfn, pairs_t& pairs);
+};
+
+#endif
@@ -0,0 +1,151 @@
+#include <algorithm>
+
+#include "m65816.hpp"
+
+// Blob layout, little-endian:
+//
+//   uint32 version, uint32 device length, device,
+//   uint32 cfg hash low, uint32 cfg hash high, uint32 port count, then for each port in address order:
+//     uint32 address, string name, string comment,
+//     uint32 bit count, then for each bit: string name, string comment
+//
+// with each string as a uint32 length followed by its characters.
+
+// Smallest encodings of a port and of a bit, with empty strings
+#define PORT_MIN_SIZE (4 + 4 + 4 + 4)
+#define BIT_MIN_SIZE  (4 + 4)
+
+// ---------------------------------------------------------------------------
+static void put_u32(bytevec_t& out, uint32 v)
+{
+	for (int i = 0; i < 4; i++)
+		out.push_back(uchar(v >> (8 * i)));
+}
+
+static void put_str(bytevec_t& out, const qstring& s)
+{
+	put_u32(out, uint32(s.length()));
+	for (size_t i = 0; i < s.length(); i++)
+		out.push_back(uchar(s[i]));
+}
+
+// Reads from [*p, end); false past the end
+static bool get_u32(const uchar** p, const uchar* end, uint32* v)
+{
+	if (end - *p < 4)
+		return false;
+	*v = 0;
+	for (int i = 0; i < 4; i++)
+		*v |= uint32((*p)[i]) << (8 * i);
+	*p += 4;
+	return true;
+}
+
+static bool get_str(const uchar** p, const uchar* end, qstring* s)
+{
+	uint32 len;
+	if (!get_u32(p, end, &len) || uint32(end - *p) < len)
+		return false;
+	s->qclear();
+	for (uint32 i = 0; i < len; i++)
+		s->append(char((*p)[i]));
+	*p += len;
+	return true;
+}
+
+// ---------------------------------------------------------------------------
+uint64 port_config_hash(iohandler_t& ioh)
+{
+	char cfgname[QMAXFILE];
+	char path[QMAXPATH];
+	ioh.get_cfg_filename(cfgname, sizeof(cfgname));
+	if (getsysfile(path, sizeof(path), cfgname, CFG_SUBDIR) == nullptr)
+		return 0;
+	FILE* fp = qfopen(path, "rb");
+	if (fp == nullptr)
+		return 0;
+
+	uint64 h = FNV1A_INIT;
+	uchar buf[4096];
+	ssize_t len;
+	while ((len = qfread(fp, buf, sizeof(buf))) > 0)
+		h = fnv1a(h, buf, size_t(len));
+	qfclose(fp);
+	return h;
+}
+
+// ---------------------------------------------------------------------------
+void save_port_cache(netnode& node, const char* device, uint64 cfg, const ioports_t& ports)
+{
+	qvector<const ioport_t*> sorted;
+	for (const ioport_t& port : ports)
+		sorted.push_back(&port);
+	std::stable_sort(sorted.begin(), sorted.end(),
+		[](const ioport_t* a, const ioport_t* b) { return a->address < b->address; });
+
+	bytevec_t blob;
+	put_u32(blob, PORT_CACHE_VERSION);
+	put_str(blob, qstring(device));
+	put_u32(blob, uint32(cfg));
+	put_u32(blob, uint32(cfg >> 32));
+	put_u32(blob, uint32(sorted.size()));
+	for (const ioport_t* port : sorted)
+	{
+		put_u32(blob, uint32(port->address));
+		put_str(blob, port->name);
+		put_str(blob, port->cmt);
+		put_u32(blob, uint32(port->bits.size()));
+		for (const ioport_bit_t& bit : port->bits)
+		{
+			put_str(blob, bit.name);
+			put_str(blob, bit.cmt);
+		}
+	}
+	node.setblob(&blob[0], blob.size(), 0, PORT_CACHE_TAG);
+}
+
+// ---------------------------------------------------------------------------
+bool load_port_cache(const netnode& node, const char* device, uint64 cfg, ioports_t* ports)
+{
+	bytevec_t blob;
+	if (node.getblob(&blob, 0, PORT_CACHE_TAG) <= 0)
+		return false;
+
+	const uchar* p = &blob[0];
+	const uchar* end = p + blob.size();
+	uint32 version, cfg_lo, cfg_hi, count;
+	qstring cached_device;
+	if (!get_u32(&p, end, &version) || version != PORT_CACHE_VERSION
+		|| !get_str(&p, end, &cached_device) || !streq(cached_device.c_str(), device)
+		|| !get_u32(&p, end, &cfg_lo) || !get_u32(&p, end, &cfg_hi)
+		|| !get_u32(&p, end, &count))
+		return false;
+	if (cfg != 0 && cfg != (uint64(cfg_hi) << 32 | cfg_lo))
+		return false;
+
+	// Counts are checked against what is left before allocating,
+	// in case the blob is truncated or corrupt
+	if (count > uint32(end - p) / PORT_MIN_SIZE)
+		return false;
+
+	ioports_t loaded;
+	loaded.resize(count);
+	for (ioport_t& port : loaded)
+	{
+		uint32 address, nbits;
+		if (!get_u32(&p, end, &address)
+			|| !get_str(&p, end, &port.name)
+			|| !get_str(&p, end, &port.cmt)
+			|| !get_u32(&p, end, &nbits))
+			return false;
+		port.address = address;
+		if (nbits > uint32(end - p) / BIT_MIN_SIZE)
+			return false;
+		port.bits.resize(nbits);
+		for (ioport_bit_t& bit : port.bits)
+			if (!get_str(&p, end, &bit.name) || !get_str(&p, end, &bit.cmt))
+				return false;
+	}
+	ports->swap(loaded);
+	return true;
+}
@@ -0,0 +1,45 @@
+#ifndef __PORTCACHE_HPP__
+#define __PORTCACHE_HPP__
+
+#include <pro.h>
+#include <netnode.hpp>
+#include "../iohandler.hpp"
+
+// The I/O ports of the device, kept in the database.
+//
+// iohandler_t reads the ports from m65816.cfg, which has hundreds of
+// them, each time a database is opened and after every undo. They only
+// change when the device does, so the table is parsed once, when the
+// database is created, and stored in the helper netnode in binary form,
+// sorted by address. Reopening and undoing read it back from there.
+// The table is keyed on the device and on a hash of the cfg file, so
+// that editing the file takes effect the next time the database is
+// opened.
+
+// Netnode tag of the port table blob
+#define PORT_CACHE_TAG 'T'
+
+// Format of the blob, bumped whenever it changes
+#define PORT_CACHE_VERSION 2
+
+/**
+ * Hash of the contents of the cfg file 'ioh' reads its ports from.
+ *
+ * returns : 0 if the file can't be read.
+ */
+uint64 port_config_hash(iohandler_t& ioh);
+
+/**
+ * Store 'ports' of 'device', read from a cfg file of hash 'cfg',
+ * in 'node'.
+ */
+void save_port_cache(netnode& node, const char* device, uint64 cfg, const ioports_t& ports);
+
+/**
+ * Read back what save_port_cache() stored, if it was for 'device' and
+ * a cfg file of hash 'cfg'. A 'cfg' of 0, for a file that can't be
+ * read, matches any.
+ */
+bool load_port_cache(const netnode& node, const char* device, uint64 cfg, ioports_t* ports);
+
+#endif
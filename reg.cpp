@@ -5,6 +5,7 @@
 #include <diskio.hpp>
 #include <cvt64.hpp>
 #include <typeinf.hpp>
+#include <algorithm>
 
 #include "m65816.hpp"
 int data_id;
@@ -31,16 +32,200 @@ static const char* const RegNames[] =
   "PB", // Program bank
 
   "m0",
-  "x0"
+  "x0",
+
+  "P"  // Packed m/x/e flags
 };
 
 
 // ---------------------------------------------------------------------------
 ea_t m65816_t::xlat(ea_t address)
 {
+	ea_t ea;
+	if (xlt.lookup(address, &ea))
+		return ea;
 	return sa->xlat(address);
 }
 
+// ---------------------------------------------------------------------------
+cpu_mode_t m65816_t::get_cpu_mode(ea_t ea)
+{
+	cpu_mode_cache_t::entry_t& entry = modes.entries[ea % CPU_MODE_CACHE_SIZE];
+	if (entry.gen == modes.gen && entry.ea == ea)
+		return entry.mode;
+
+	cpu_mode_t& cm = entry.mode;
+	cm.mode = pstate_to_mode(get_pstate(ea));
+	cm.db = sregs.get(ea, rB);
+	cm.dp = sregs.get(ea, rD);
+	cm.pb = sregs.get(ea, rPB);
+
+	entry.ea = ea;
+	entry.gen = modes.gen;
+	return cm;
+}
+
+// ---------------------------------------------------------------------------
+// Older databases keep M and X in two registers each: the "logical"
+// rFm/rFx and the inverted rOm/rOx. Whichever range starts last wins.
+static bool get_logical_flags(ea_t ea, int rg) {
+	sreg_range_t range, other;
+	int org = rg == rFm ? rOm : rOx;
+
+	bool has_range = get_sreg_range(&range, ea, rg);
+	bool has_other = get_sreg_range(&other, ea, org);
+
+	if (has_range) {
+		if (has_other) {
+			if (other.start_ea > range.start_ea)
+				return other.val == 0;
+			if (range.start_ea > other.start_ea || range.val != other.val)
+				return range.val != 0;
+		}
+		else
+			return range.val != 0;
+	}
+	else if (has_other)
+		return other.val == 0;
+
+	//Default
+	return false;
+}
+
+// ---------------------------------------------------------------------------
+static sel_t get_legacy_pstate(ea_t ea)
+{
+	sel_t e = get_sreg(ea, rFe);
+	return (get_logical_flags(ea, rFm) ? PS_M : 0)
+		| (get_logical_flags(ea, rFx) ? PS_X : 0)
+		| (e != 0 && e != BADSEL ? PS_E : 0);
+}
+
+// ---------------------------------------------------------------------------
+// Rebuilds rP from the m/x/e registers of databases created before it
+// existed, then drops their ranges. Done once; the "pstate" hash value
+// of the helper node records that the database is up to date.
+void m65816_t::upgrade_pstate()
+{
+	static const int legacy[] = { rFm, rFx, rFe, rOm, rOx };
+
+	if (helper.hashval_long("pstate") != 0)
+		return;
+
+	// Every address where one of the old registers changes
+	eavec_t starts;
+	for (int rg : legacy)
+	{
+		int n = int(get_sreg_ranges_qty(rg));
+		for (int i = 0; i < n; i++)
+		{
+			sreg_range_t range;
+			if (getn_sreg_range(&range, rg, i))
+				starts.push_back(range.start_ea);
+		}
+	}
+	std::sort(starts.begin(), starts.end());
+	starts.erase(std::unique(starts.begin(), starts.end()), starts.end());
+
+	// Compute all the new values before touching anything
+	qvector<sreg_range_t> ranges;
+	for (ea_t ea : starts)
+	{
+		sreg_range_t& r = ranges.push_back();
+		r.start_ea = ea;
+		r.val = get_legacy_pstate(ea);
+		r.tag = SR_auto;
+		for (int rg : legacy)
+		{
+			sreg_range_t range;
+			if (get_sreg_range(&range, ea, rg) && range.start_ea == ea && range.tag == SR_user)
+				r.tag = SR_user;
+		}
+
+		segment_t* seg = getseg(ea);
+		if (seg != nullptr && seg->start_ea == ea)
+		{
+			// The segment's default, unless the user gave it
+			set_default_sreg_value(seg, rP, r.val);
+			r.val |= r.tag == SR_user ? PS_ORG_USER : PS_ORG_DEFAULT;
+			continue;
+		}
+
+		// The old registers don't say where a value came from,
+		// but the instruction ending right before it does.
+		uint8 prev = get_byte(get_item_head(ea - 1));
+		uint16 itype = get_opcode_info(prev).itype;
+		if (r.tag == SR_user)
+			r.val |= PS_ORG_USER;
+		else if (itype == M65816_sep || itype == M65816_rep
+			|| itype == M65816_xce || itype == M65816_plp)
+			r.val |= PS_ORG_INSN;
+		else
+			r.val |= PS_ORG_FLOW;
+	}
+
+	for (const sreg_range_t& r : ranges)
+		split_sreg_range(r.start_ea, rP, r.val, r.tag);
+
+	for (int rg : legacy)
+		for (ea_t ea : starts)
+			del_sreg_range(ea, rg);
+
+	helper.hashset_idx("pstate", 1);
+	modes.invalidate();
+	sregs.invalidate();
+}
+
+// ---------------------------------------------------------------------------
+cpu_mode_t get_cpu_mode(ea_t ea)
+{
+	return GET_MODULE_DATA(m65816_t)->get_cpu_mode(ea);
+}
+
+// ---------------------------------------------------------------------------
+sel_t read_sreg(ea_t ea, int rg)
+{
+	return GET_MODULE_DATA(m65816_t)->sregs.get(ea, rg);
+}
+
+// ---------------------------------------------------------------------------
+bool read_sreg_range(sreg_range_t* out, ea_t ea, int rg)
+{
+	return GET_MODULE_DATA(m65816_t)->sregs.get_range(out, ea, rg);
+}
+
+// ---------------------------------------------------------------------------
+void split_sreg(ea_t ea, int rg, sel_t val)
+{
+	m65816_t& pm = *GET_MODULE_DATA(m65816_t);
+	if (pm.sregs.set(ea, rg, val))
+		pm.modes.invalidate();
+}
+
+// ---------------------------------------------------------------------------
+void flush_sregs()
+{
+	GET_MODULE_DATA(m65816_t)->sregs.flush();
+}
+
+// ---------------------------------------------------------------------------
+const func_summary_t& get_func_summary(func_t* pfn)
+{
+	return GET_MODULE_DATA(m65816_t)->summaries.get(pfn);
+}
+
+// ---------------------------------------------------------------------------
+head_index_t& get_head_index()
+{
+	return GET_MODULE_DATA(m65816_t)->heads;
+}
+
+// ---------------------------------------------------------------------------
+const cop_desc_t& get_cop_desc(uint8 sig)
+{
+	return GET_MODULE_DATA(m65816_t)->cops.get(sig);
+}
+
 // ---------------------------------------------------------------------------
 m65816_t::m65816_t()
 {
@@ -119,12 +304,209 @@ ssize_t idaapi idb_listener_t::on_event(ssize_t code, va_list va)
 {
 	switch (code)
 	{
+	case idb_event::segm_added:
+	case idb_event::segm_deleted:
+	case idb_event::segm_attrs_updated:
+		pm.modes.invalidate();
+		pm.sregs.invalidate();
+		pm.btcache.clear();
+		pm.heads.clear();
+		pm.consts.clear();
+		break;
+
+	case idb_event::func_added:
+	{
+		func_t* pfn = va_arg(va, func_t*);
+		pm.mxflow.mark(pfn->start_ea);
+		pm.heads.set_func_start(pfn->start_ea, true);
+		pm.btcache.invalidate(pfn->start_ea, pfn->start_ea + 1);
+		pm.consts.invalidate(pfn->start_ea, pfn->start_ea + 1);
+	}
+	break;
+
+	// The function's code changed
+	case idb_event::func_updated:
+	case idb_event::set_func_end:
+	case idb_event::func_tail_appended:
+	case idb_event::func_tail_deleted:
+	case idb_event::deleting_func:
+	{
+		func_t* pfn = va_arg(va, func_t*);
+		pm.summaries.invalidate(pfn->start_ea);
+		pm.phpmatch.invalidate(pfn->start_ea);
+		if (code == idb_event::deleting_func)
+		{
+			pm.heads.set_func_start(pfn->start_ea, false);
+			pm.btcache.invalidate(pfn->start_ea, pfn->start_ea + 1);
+			pm.consts.invalidate(pfn->start_ea, pfn->start_ea + 1);
+		}
+	}
+	break;
+
+	case idb_event::set_func_start:
+	{
+		func_t* pfn = va_arg(va, func_t*);
+		ea_t new_start = va_arg(va, ea_t);
+		pm.summaries.invalidate(pfn->start_ea);
+		pm.phpmatch.invalidate(pfn->start_ea);
+		pm.heads.set_func_start(pfn->start_ea, false);
+		pm.heads.set_func_start(new_start, true);
+		pm.btcache.invalidate(pfn->start_ea, pfn->start_ea + 1);
+		pm.btcache.invalidate(new_start, new_start + 1);
+		pm.consts.invalidate(pfn->start_ea, pfn->start_ea + 1);
+		pm.consts.invalidate(new_start, new_start + 1);
+	}
+	break;
+
+	case idb_event::make_code:
+	{
+		const insn_t* insn = va_arg(va, const insn_t*);
+		pm.summaries.invalidate(insn->ea);
+		pm.phpmatch.invalidate(insn->ea);
+		pm.heads.set_code(insn->ea);
+		pm.btcache.invalidate(insn->ea, insn->ea + insn->size);
+		pm.consts.invalidate(insn->ea, insn->ea + insn->size);
+	}
+	break;
+
+	case idb_event::make_data:
+	{
+		ea_t ea = va_arg(va, ea_t);
+		flags64_t flags = va_arg(va, flags64_t);
+		tid_t tid = va_arg(va, tid_t);
+		asize_t len = va_arg(va, asize_t);
+		pm.heads.set_data(ea, len);
+		pm.btcache.invalidate(ea, ea + len);
+		pm.consts.invalidate(ea, ea + len);
+		if (is_struct(flags) && tid != BADADDR)
+			pm.strucrefs.mark(ea);
+	}
+	break;
+
+	case idb_event::op_type_changed:
+	case idb_event::ti_changed:
+		pm.strucrefs.mark(va_arg(va, ea_t));
+		break;
+
+	case idb_event::struc_member_created:
+	case idb_event::struc_member_deleted:
+	case idb_event::struc_member_changed:
+	case idb_event::struc_expanded:
+	{
+		struc_t* sptr = va_arg(va, struc_t*);
+		pm.strucrefs.invalidate(sptr->id);
+	}
+	break;
+
+	case idb_event::deleting_struc:
+	{
+		struc_t* sptr = va_arg(va, struc_t*);
+		pm.strucrefs.forget(sptr->id);
+	}
+	break;
+
+	case idb_event::struc_renamed:
+		pm.strucrefs.invalidate();
+		break;
+
+	case idb_event::destroyed_items:
+	{
+		ea_t ea1 = va_arg(va, ea_t);
+		ea_t ea2 = va_arg(va, ea_t);
+		pm.summaries.invalidate(ea1, ea2);
+		pm.phpmatch.invalidate(ea1, ea2);
+		pm.heads.del_items(ea1, ea2);
+		pm.btcache.invalidate(ea1, ea2);
+		pm.consts.invalidate(ea1, ea2);
+	}
+	break;
+
+	case idb_event::byte_patched:
+	{
+		ea_t ea = va_arg(va, ea_t);
+		pm.summaries.invalidate(ea);
+		pm.phpmatch.invalidate(ea, ea + 1);
+		pm.btcache.invalidate(ea, ea + 1);
+		pm.consts.invalidate(ea, ea + 1);
+	}
+	break;
+
+	case idb_event::auto_empty:
+		pm.callgraph.run(pm.summaries, pm.mxflow);
+		pm.mxflow.run();
+		pm.strucrefs.run([this](ea_t address) { return pm.xlat(address); });
+		break;
+
+	case idb_event::sgr_deleted:
+	{
+		ea_t start_ea = va_arg(va, ea_t);
+		ea_t end_ea = va_arg(va, ea_t);
+		int regnum = va_arg(va, int);
+		pm.modes.invalidate();
+		pm.sregs.invalidate(regnum);
+		pm.btcache.invalidate(start_ea, end_ea);
+		pm.consts.sreg_changed(start_ea, end_ea, regnum);
+		if (regnum == rP)
+			pm.summaries.invalidate(start_ea, end_ea);
+	}
+	break;
+
+	case idb_event::auto_empty_finally:
+		if (pm.sregs.written + pm.sregs.suppressed != 0)
+			msg("m65816: %u segment register writes, %u skipped as unchanged\n",
+				pm.sregs.written, pm.sregs.suppressed);
+		if (pm.btcache.hits + pm.btcache.misses != 0)
+			msg("m65816: backtracking cache: %u hits, %u misses, %u entries dropped\n",
+				pm.btcache.hits, pm.btcache.misses, pm.btcache.dropped);
+		if (pm.callgraph.runs != 0)
+			msg("m65816: call graph: %u runs, %u functions built, %u solved states reused\n",
+				pm.callgraph.runs, pm.callgraph.rebuilt, pm.mxflow.reused);
+		if (pm.mxflow.unsolved != 0)
+			msg("m65816: M/X dataflow: %u functions left unsolved at the visit limit\n",
+				pm.mxflow.unsolved);
+		if (pm.phpmatch.lookups != 0)
+			msg("m65816: %u PLP lookups, %u functions paired\n",
+				pm.phpmatch.lookups, pm.phpmatch.builds);
+		if (pm.jtstats.bounded + pm.jtstats.unbounded != 0)
+			msg("m65816: jump tables: %u sized from the code, %u scanned, %u rejected, %u entries\n",
+				pm.jtstats.bounded, pm.jtstats.unbounded, pm.jtstats.rejected, pm.jtstats.entries);
+		if (pm.strucrefs.items != 0)
+			msg("m65816: %u references from the addr members of %u items, %u structures scanned\n",
+				pm.strucrefs.refs, pm.strucrefs.items, pm.strucrefs.builds);
+		if (pm.consts.lookups != 0)
+			msg("m65816: %u D/DB lookups, %u blocks propagated\n",
+				pm.consts.lookups, pm.consts.builds);
+		if (pm.cart.undos != 0)
+			msg("m65816: %u undo steps, %.2f ms on average, %.2f ms at most, %u cartridge reloads skipped\n",
+				pm.cart.undos, double(pm.cart.undo_nsec) / pm.cart.undos / 1e6,
+				double(pm.cart.undo_max_nsec) / 1e6, pm.cart.skips);
+		if (pm.btstats.queries != 0)
+		{
+			const bt_stats_t& st = pm.btstats;
+			msg("m65816: backtracking: %u queries, %.1f instructions on average, %u at most, %u joins\n",
+				st.queries, double(st.walked) / st.queries, st.max_walk, st.joins);
+			msg("m65816: backtracking: %u resolved, %u unknown, %u stopped at a boundary, "
+				"%u out of budget (%u), %u cached\n",
+				st.stops[BTS_VALUE], st.stops[BTS_UNKNOWN], st.stops[BTS_BOUNDARY],
+				st.stops[BTS_BUDGET], pm.bt_budget, st.stops[BTS_CACHED]);
+		}
+		break;
+
 	case idb_event::sgr_changed:
 	{
+		pm.modes.invalidate();
 		ea_t start_ea = va_arg(va, ea_t);
-		ea_t dummy = va_arg(va, ea_t); qnotused(dummy);
+		ea_t end_ea = va_arg(va, ea_t);
 		int regnum = va_arg(va, int);
 		sel_t value = va_arg(va, sel_t);
+		pm.sregs.changed(start_ea, regnum, value);
+		pm.btcache.invalidate(start_ea, end_ea);
+		pm.consts.sreg_changed(start_ea, end_ea, regnum);
+		if (regnum == rP)
+		{
+			pm.mxflow.mark(start_ea);
+			pm.summaries.invalidate(start_ea, end_ea);
+		}
 		if (regnum == rB)
 		{
 			//        sel_t d2 = va_arg(va, sel_t); qnotused(d2);
@@ -133,6 +515,22 @@ ssize_t idaapi idb_listener_t::on_event(ssize_t code, va_list va)
 			else
 				split_sreg_range(start_ea, rDs, value << 12, SR_auto);
 		}
+		else if (is_legacy_flag_sreg(regnum))
+		{
+			// Fold user edits of the old m/x/e registers into rP
+			sel_t old_value = va_arg(va, sel_t); qnotused(old_value);
+			uchar tag = uchar(va_arg(va, int));
+			if (tag != SR_user || value == BADSEL)
+				break;
+
+			sel_t bit = (regnum == rFm || regnum == rOm) ? PS_M
+				: (regnum == rFx || regnum == rOx) ? PS_X
+				: PS_E;
+			bool set = (value != 0) != (regnum == rOm || regnum == rOx);
+			sel_t p = get_pstate(start_ea);
+			p = set ? (p | bit) : (p & ~bit);
+			split_sreg_range(start_ea, rP, p | PS_ORG_USER, SR_user);
+		}
 		else if (regnum == rPB)
 		{
 			uint16 offset = start_ea & 0xffff;
@@ -153,13 +551,88 @@ ssize_t idaapi idb_listener_t::on_event(ssize_t code, va_list va)
 //----------------------------------------------------------------------
 void m65816_t::load_from_idb()
 {
+	modes.invalidate();
+	sregs.invalidate();
+	mxflow.clear();
+	summaries.load();
+	callgraph.clear();
+	phpmatch.clear();
+	heads.clear();
+	btcache.clear();
+	consts.clear();
+	strucrefs.clear();
+	bt_budget = uint32(helper.hashval_long("bt_budget"));
+	if (bt_budget == 0)
+		bt_budget = BT_DEFAULT_BUDGET;
+	cops.load();
+
+	// The rest only depends on the hash of the helper node,
+	// which an undo step seldom touches
+	if (!cart.changed(helper))
+		return;
+
 	cartridge->read_hash(helper);
 	//cartridge.print();
 	if (!sa->addr_init(*cartridge))
 		warning("Unsupported mapper: %s", cartridge->mapper_string());
-	ioh.restore_device(IORESP_NONE);
+	xlt.build([this](ea_t address) { return sa->xlat(address); });
+
+	// The ports stored when the database was created, rather
+	// than parsing the cfg file again, unless the file changed
+	qstring device;
+	uint64 cfg = port_config_hash(ioh);
+	if (helper.hashstr(&device, "device") > 0
+		&& load_port_cache(helper, device.c_str(), cfg, &ioh.ports))
+	{
+		ioh.device = device;
+	}
+	else
+	{
+		ioh.restore_device(IORESP_NONE);
+		save_port_cache(helper, ioh.device.c_str(), cfg, ioh.ports);
+	}
 }
 
+//----------------------------------------------------------------------
+// IDC functions, for scripts that correlate the database with traces
+// or emulator breakpoints:
+//
+//   long m65816_xlat(long bus)              // Bus address to ea
+//   long m65816_bus_addr(long ea)           // ea to bus address
+//   long m65816_bus_alias(long ea, long n)  // n-th bus address of ea, lowest first
+//
+// All return BADADDR if there is no such address.
+static const char idc_args_1[] = { VT_LONG, 0 };
+static const char idc_args_2[] = { VT_LONG, VT_LONG, 0 };
+
+static error_t idaapi idc_xlat(idc_value_t* argv, idc_value_t* res)
+{
+	res->num = GET_MODULE_DATA(m65816_t)->xlat(ea_t(argv[0].num));
+	return eOk;
+}
+
+static error_t idaapi idc_bus_addr(idc_value_t* argv, idc_value_t* res)
+{
+	res->num = GET_MODULE_DATA(m65816_t)->xlt.bus_addr(ea_t(argv[0].num));
+	return eOk;
+}
+
+static error_t idaapi idc_bus_alias(idc_value_t* argv, idc_value_t* res)
+{
+	eavec_t all;
+	size_t n = GET_MODULE_DATA(m65816_t)->xlt.aliases(ea_t(argv[0].num), &all);
+	sval_t i = sval_t(argv[1].num);
+	res->num = i >= 0 && size_t(i) < n ? all[i] : BADADDR;
+	return eOk;
+}
+
+static const ext_idcfunc_t idc_funcs[] =
+{
+	{ "m65816_xlat", idc_xlat, idc_args_1, nullptr, 0, 0 },
+	{ "m65816_bus_addr", idc_bus_addr, idc_args_1, nullptr, 0, 0 },
+	{ "m65816_bus_alias", idc_bus_alias, idc_args_2, nullptr, 0, 0 },
+};
+
 //----------------------------------------------------------------------
 // This old-style callback only returns the processor module object.
 static ssize_t idaapi notify(void*, int msgid, va_list)
@@ -179,13 +652,87 @@ ssize_t idaapi m65816_t::on_event(ssize_t msgid, va_list va)
 	case processor_t::ev_init:
 		hook_event_listener(HT_IDB, &idb_listener, &LPH);
 		helper.create(PROCMOD_NODE_NAME);
+		for (const ext_idcfunc_t& f : idc_funcs)
+			add_idc_func(f);
 		break;
 	case processor_t::ev_term:
+		for (const ext_idcfunc_t& f : idc_funcs)
+			del_idc_func(f.name);
 		unhook_event_listener(HT_IDB, &idb_listener);
 		clr_module_data(data_id);
 		break;
 	case processor_t::ev_newprc:
 		break;
+	case processor_t::ev_set_idp_options:
+	{
+		// M65816_BT_BUDGET, M65816_COP_DIALECT, or the options dialog
+		const char* keyword = va_arg(va, const char*);
+		int value_type = va_arg(va, int);
+		const void* value = va_arg(va, const void*);
+		const char** errbuf = va_arg(va, const char**);
+		bool idb_loaded = va_argi(va, bool);
+
+		sval_t budget = bt_budget;
+		qstring dialect(cops.name());
+		if (keyword == nullptr)
+		{
+			static const char form[] =
+				"M65816 analysis options\n"
+				"\n"
+				"<~B~acktracking budget (instructions per query):D:10:10::>\n"
+				"<~C~OP dialect (see " COP_DIALECT_FILE "):q:32:16::>\n"
+				"\n";
+			if (ask_form(form, &budget, &dialect) <= 0)
+				return 0;
+		}
+		else if (streq(keyword, "M65816_BT_BUDGET"))
+		{
+			if (value_type != IDPOPT_NUM)
+				return -1;
+			budget = *(const uval_t*)value;
+		}
+		else if (streq(keyword, "M65816_COP_DIALECT"))
+		{
+			if (value_type != IDPOPT_STR)
+				return -1;
+			dialect = (const char*)value;
+		}
+		else
+		{
+			return 0;
+		}
+
+		if (budget <= 0)
+		{
+			if (errbuf != nullptr)
+				*errbuf = "The backtracking budget must be positive";
+			return -1;
+		}
+
+		// Checked now, so that a name that doesn't exist is reported
+		if (!streq(dialect.c_str(), cops.name()))
+		{
+			static qstring error;
+			error.qclear();
+			if (!cops.select(dialect.c_str(), idb_loaded, &error))
+			{
+				if (errbuf != nullptr)
+					*errbuf = error.c_str();
+				return -1;
+			}
+			if (idb_loaded)
+				msg("m65816: COP dialect is now '%s'; reanalyze the program to apply it to existing code\n",
+					cops.name());
+			else
+				cop_option = dialect;
+		}
+
+		bt_budget = uint32(budget);
+		btcache.clear();
+		if (idb_loaded)
+			helper.hashset("bt_budget", bt_budget);
+	}
+	break;
 	case processor_t::ev_creating_segm:
 	{
 		segment_t* sptr = va_arg(va, segment_t*);
@@ -212,10 +759,32 @@ ssize_t idaapi m65816_t::on_event(ssize_t msgid, va_list va)
 	break;
 	case processor_t::ev_newfile:
 	{
+		modes.invalidate();
+		sregs.invalidate();
+		mxflow.clear();
+		callgraph.clear();
+		phpmatch.clear();
+		heads.clear();
+		btcache.clear();
+		consts.clear();
+		strucrefs.clear();
+		cart.clear();
+		if (bt_budget != BT_DEFAULT_BUDGET)
+			helper.hashset("bt_budget", bt_budget);
+		{
+			qstring dialect = cop_option.empty() ? cop_dialects_t::default_name() : cop_option;
+			qstring error;
+			if (!cops.select(dialect.c_str(), true, &error))
+			{
+				warning("%s, using the built-in COP dialect", error.c_str());
+				cops.select(COP_DIALECT_BUILTIN, true, &error);
+			}
+		}
 		cartridge->read_hash(helper);
 		//cartridge.print();
 		if (!sa->addr_init(*cartridge))
 			warning("Unsupported mapper: %s", cartridge->mapper_string());
+		xlt.build([this](ea_t address) { return sa->xlat(address); });
 
 		const char* device_ptr = nullptr;
 		if (cartridge->has_superfx)
@@ -258,15 +827,14 @@ ssize_t idaapi m65816_t::on_event(ssize_t msgid, va_list va)
 				device_ptr = loader_device.c_str();
 		}
 		ioh.set_device_name(device_ptr, IORESP_ALL);
+		save_port_cache(helper, ioh.device.c_str(), port_config_hash(ioh), ioh.ports);
 
 		//It is more appropriate to clear m/x/e since the RESET vector should do this automatically
 		//Having these cleared by default SHOULD mean that new code will pick up a post-reset state
-		set_default_sreg_value(nullptr, rFm, 0);
-		set_default_sreg_value(nullptr, rFx, 0);
-		set_default_sreg_value(nullptr, rFe, 0);
+		set_default_sreg_value(nullptr, rP, 0);
 		set_default_sreg_value(nullptr, rD, 0);
-		set_default_sreg_value(nullptr, rOm, 1);
-		set_default_sreg_value(nullptr, rOx, 1);
+		helper.hashset_idx("pstate", 1);
+		helper.hashset_idx("strucrefs", 1);
 
 		// see processor_t::ev_creating_segm for the following registers
 		//set_default_sreg_value(nullptr, rPB, 0);
@@ -279,6 +847,7 @@ ssize_t idaapi m65816_t::on_event(ssize_t msgid, va_list va)
 			ea_t sea = getseg(reset_ea)->start_ea;
 
 			xfer_sregs(sea, reset_ea);
+			flush_sregs();
 
 			/*	split_sreg_range(reset_ea, rFm, get_sreg(sea, rFm), SR_auto);
 				split_sreg_range(reset_ea, rFx, get_sreg(sea, rFx), SR_auto);
@@ -292,9 +861,34 @@ ssize_t idaapi m65816_t::on_event(ssize_t msgid, va_list va)
 	case processor_t::ev_ending_undo:
 	case processor_t::ev_oldfile:
 	{
-		load_from_idb();
+		if (msgid == processor_t::ev_ending_undo)
+		{
+			uint64 start = get_nsec_stamp();
+			load_from_idb();
+			uint64 elapsed = get_nsec_stamp() - start;
+			cart.undos++;
+			cart.undo_nsec += elapsed;
+			cart.undo_max_nsec = qmax(cart.undo_max_nsec, elapsed);
+		}
+		else
+		{
+			cart.clear();
+			load_from_idb();
+		}
 		if (msgid == processor_t::ev_oldfile)
-		{ // read rommode_t for backward compatibility
+		{
+			upgrade_pstate();
+
+			// Databases from before the references of 'addr' members
+			// were added at analysis time
+			if (helper.hashval_long("strucrefs") == 0)
+			{
+				strucrefs.mark_all();
+				strucrefs.run([this](ea_t address) { return xlat(address); });
+				helper.hashset_idx("strucrefs", 1);
+			}
+
+			// read rommode_t for backward compatibility
 			nodeidx_t mode = helper.hashval_long("rommode_t");
 			if (mode != 0)
 			{
@@ -314,6 +908,18 @@ ssize_t idaapi m65816_t::on_event(ssize_t msgid, va_list va)
 		}
 	}
 	break;
+	// A new path into 'to', or one less, for the backtracking
+	// results that went through it
+	case processor_t::ev_add_cref:
+	case processor_t::ev_del_cref:
+	{
+		ea_t from = va_arg(va, ea_t); qnotused(from);
+		ea_t to = va_arg(va, ea_t);
+		btcache.invalidate(to, to + 1);
+		consts.invalidate(to, to + 1);
+	}
+	return 0;
+
 	case processor_t::ev_get_autocmt:
 	{
 		qstring* buf = va_arg(va, qstring*);
@@ -439,60 +1045,6 @@ ssize_t idaapi m65816_t::on_event(ssize_t msgid, va_list va)
 		return out_opnd(*ctx, *op) ? 1 : -1;
 	}
 
-	case processor_t::ev_out_data:
-	{
-		outctx_t* ctx = va_arg(va, outctx_t*);
-		const bool analyze_only = va_arg(va, const bool);
-		if (!analyze_only) {
-			ea_t ref = get_first_dref_from(ctx->insn_ea);
-			if (ref < 0 || ref > 0x100000000) {
-				opinfo_t op = opinfo_t();
-				get_opinfo(&op, ctx->insn_ea, 0, ctx->F);
-				//qstring name = get_struc_name(op.tid, ctx->F);
-				//search_addr_member(ctx, op.tid);
-				
-				if (op.tid != BADADDR) {
-					qstring qs;
-					ea_t addr;
-
-					//Check for addr
-					if (get_struc_name(&qs, op.tid) && qs.compare("addr") == 0) {
-						addr = ea_t(get_byte(ctx->insn_ea + 2)) << 16 | get_word(ctx->insn_ea);
-						addr = xlat(addr);
-						add_dref(ctx->insn_ea, addr, dr_R);
-					}
-					else {
-						const struc_t* struc = get_struc(op.tid);
-						asize_t offset = 0;
-						asize_t size = get_struc_size(op.tid);
-
-						while (offset < size) {
-							tinfo_t tinfo;
-							member_t* member = get_member(struc, offset);
-							if (get_member_tinfo(&tinfo, member) && tinfo.is_struct() && tinfo.get_type_name(&qs)) {
-								if (qs.compare("addr") == 0) {
-									addr = ea_t(get_byte(ctx->insn_ea + offset + 2)) << 16 | get_word(ctx->insn_ea + offset);
-									addr = xlat(addr);
-									//addr = map_data_ea(ctx->insn, addr, 0);
-									add_dref(ctx->insn_ea, addr, dr_R);
-
-								}
-								else {
-									/*type_t typ = tinfo.get_decltype();
-									udt_type_data_t udt;
-									tinfo.get_udt_details(&udt);
-									tinfo.get_til*/
-								}
-							}
-							offset += member->get_size();
-						}
-					}
-				}
-			}
-		}
-		return 0;
-	}
-
 #ifdef ENABLE_MERGE
 #endif
 
@@ -781,7 +1333,7 @@ RegNames,                     // Register names
 qnumber(RegNames),            // Number of registers
 
 rCs,                          // first segreg
-rOx,                          // last  segreg
+rP,                           // last  segreg
 0,                            // size of a segment register
 rCs,                          // number of CS register
 rDs,                          // number of DS register
@@ -0,0 +1,143 @@
+#include "sreg.hpp"
+
+// ---------------------------------------------------------------------------
+// Interval containing 'ea', fetched from IDA if it isn't known yet.
+// Returns known[].end() if the register has no value there.
+sreg_shadow_t::intervals_t::iterator sreg_shadow_t::find(ea_t ea, int rg)
+{
+	intervals_t& map = known[rg - rCs];
+
+	intervals_t::iterator it = map.upper_bound(ea);
+	if (it != map.begin())
+	{
+		--it;
+		if (ea < it->second.end)
+			return it;
+	}
+
+	sreg_range_t range;
+	if (!get_sreg_range(&range, ea, rg))
+		return map.end();
+
+	interval_t iv = { range.end_ea, range.val, range.tag };
+	return map.insert(std::make_pair(range.start_ea, iv)).first;
+}
+
+// ---------------------------------------------------------------------------
+sel_t sreg_shadow_t::get(ea_t ea, int rg)
+{
+	if (rg < rCs || rg > rP)
+		return get_sreg(ea, rg);
+
+	intervals_t::iterator it = find(ea, rg);
+	return it == known[rg - rCs].end() ? BADSEL : it->second.val;
+}
+
+// ---------------------------------------------------------------------------
+bool sreg_shadow_t::get_range(sreg_range_t* out, ea_t ea, int rg)
+{
+	if (rg < rCs || rg > rP)
+		return get_sreg_range(out, ea, rg);
+
+	intervals_t::iterator it = find(ea, rg);
+	if (it == known[rg - rCs].end())
+		return false;
+
+	out->start_ea = it->first;
+	out->end_ea = it->second.end;
+	out->val = it->second.val;
+	out->tag = it->second.tag;
+	return true;
+}
+
+// ---------------------------------------------------------------------------
+bool sreg_shadow_t::set(ea_t ea, int rg, sel_t val, uchar tag)
+{
+	if (rg < rCs || rg > rP)
+	{
+		split_sreg_range(ea, rg, val, tag);
+		written++;
+		return true;
+	}
+
+	intervals_t& map = known[rg - rCs];
+	intervals_t::iterator it = find(ea, rg);
+	if (it != map.end())
+	{
+		if (it->second.val == val && tag == SR_auto)
+		{
+			suppressed++;
+			return false;
+		}
+
+		// Same split IDA will make: [start, ea) keeps the old
+		// value, [ea, end) gets the new one.
+		interval_t tail = { it->second.end, val, tag };
+		if (it->first == ea)
+			it->second = tail;
+		else
+		{
+			it->second.end = ea;
+			map[ea] = tail;
+		}
+	}
+
+	for (pending_t& p : pending)
+	{
+		if (p.ea == ea && p.rg == rg)
+		{
+			p.val = val;
+			p.tag = tag;
+			return true;
+		}
+	}
+	pending_t& p = pending.push_back();
+	p.ea = ea;
+	p.rg = rg;
+	p.val = val;
+	p.tag = tag;
+	return true;
+}
+
+// ---------------------------------------------------------------------------
+void sreg_shadow_t::flush()
+{
+	// Writes may trigger events that queue more of them
+	while (!pending.empty())
+	{
+		qvector<pending_t> batch;
+		batch.swap(pending);
+		for (const pending_t& p : batch)
+		{
+			flushing = &p;
+			split_sreg_range(p.ea, p.rg, p.val, p.tag);
+			written++;
+		}
+		flushing = nullptr;
+	}
+}
+
+// ---------------------------------------------------------------------------
+void sreg_shadow_t::invalidate()
+{
+	for (intervals_t& map : known)
+		map.clear();
+}
+
+// ---------------------------------------------------------------------------
+void sreg_shadow_t::invalidate(int rg)
+{
+	if (rg >= rCs && rg <= rP)
+		known[rg - rCs].clear();
+}
+
+// ---------------------------------------------------------------------------
+void sreg_shadow_t::changed(ea_t ea, int rg, sel_t val)
+{
+	if (flushing != nullptr
+		&& flushing->ea == ea
+		&& flushing->rg == rg
+		&& flushing->val == val)
+		return;
+	invalidate(rg);
+}
@@ -0,0 +1,90 @@
+#ifndef __SREG_HPP__
+#define __SREG_HPP__
+
+#include <pro.h>
+#include <segregs.hpp>
+#include <map>
+#include "decode.hpp"
+
+/**
+ * Shadow of the segment register ranges, in front of split_sreg_range.
+ *
+ * Emulation propagates the M/X/E flags and the bank registers to every
+ * jump, call and branch target, and most of those writes would store
+ * the value the range already has. Each of them still costs a database
+ * write, and may get the target reanalyzed.
+ *
+ * Values read from IDA are remembered per register as [start, end)
+ * intervals. A write is only queued if the shadow says it changes the
+ * value at that address, and queued writes reach IDA on flush(). Reads
+ * made through get() see the queued writes.
+ */
+class sreg_shadow_t
+{
+public:
+	/**
+	 * Value of register 'rg' at 'ea', or BADSEL if there is none.
+	 */
+	sel_t get(ea_t ea, int rg);
+
+	/**
+	 * Same as get_sreg_range(), including the queued writes.
+	 */
+	bool get_range(sreg_range_t* out, ea_t ea, int rg);
+
+	/**
+	 * Queue split_sreg_range(ea, rg, val, tag).
+	 *
+	 * returns : false if the value at 'ea' was already 'val', and
+	 *           nothing was queued.
+	 */
+	bool set(ea_t ea, int rg, sel_t val, uchar tag = SR_auto);
+
+	/**
+	 * Hand the queued writes over to IDA.
+	 */
+	void flush();
+
+	/**
+	 * Forget what is known about all registers, or one of them.
+	 * Queued writes are kept.
+	 */
+	void invalidate();
+	void invalidate(int rg);
+
+	/**
+	 * To be called from the sgr_changed event. Changes made by
+	 * flush() are already known; anything else invalidates 'rg'.
+	 */
+	void changed(ea_t ea, int rg, sel_t val);
+
+	uint32 written = 0;    // Writes passed on to IDA
+	uint32 suppressed = 0; // Writes that would not have changed anything
+
+private:
+	struct interval_t
+	{
+		ea_t end;
+		sel_t val;
+		uchar tag;
+	};
+	typedef std::map<ea_t, interval_t> intervals_t;
+
+	struct pending_t
+	{
+		ea_t ea;
+		int rg;
+		sel_t val;
+		uchar tag;
+	};
+
+	static const int nregs = rP - rCs + 1;
+
+	intervals_t known[nregs];
+	qvector<pending_t> pending;
+	const pending_t* flushing = nullptr;
+
+	intervals_t::iterator find(ea_t ea, int rg);
+};
+
+#endif
@@ -0,0 +1,121 @@
+#include "m65816.hpp"
+
+// ---------------------------------------------------------------------------
+static bool is_addr_name(const qstring& name)
+{
+	return name.compare("addr") == 0;
+}
+
+// ---------------------------------------------------------------------------
+void struc_refs_t::mark(ea_t ea)
+{
+	dirty.insert(ea);
+}
+
+// ---------------------------------------------------------------------------
+static bool idaapi is_struct_item(flags64_t F, void*)
+{
+	return is_struct(F);
+}
+
+// ---------------------------------------------------------------------------
+// The items of the structures in 'changed', or of any if 'rescan'
+void struc_refs_t::mark_instances()
+{
+	for (int n = 0; n < get_segm_qty(); n++)
+	{
+		const segment_t* seg = getnseg(n);
+		ea_t ea = seg->start_ea;
+		if (!is_struct(get_flags(ea)))
+			ea = next_that(ea, seg->end_ea, is_struct_item);
+		for (; ea != BADADDR; ea = next_that(ea, seg->end_ea, is_struct_item))
+		{
+			if (!rescan)
+			{
+				opinfo_t op = opinfo_t();
+				if (get_opinfo(&op, ea, 0, get_flags(ea)) == nullptr || changed.count(op.tid) == 0)
+					continue;
+			}
+			dirty.insert(ea);
+		}
+	}
+	changed.clear();
+	rescan = false;
+}
+
+// ---------------------------------------------------------------------------
+const qvector<asize_t>& struc_refs_t::addr_offsets(tid_t tid)
+{
+	std::map<tid_t, qvector<asize_t> >::iterator it = offsets.find(tid);
+	if (it != offsets.end())
+		return it->second;
+	builds++;
+
+	qvector<asize_t>& offs = offsets[tid];
+	qstring name;
+	if (get_struc_name(&name, tid) && is_addr_name(name))
+	{
+		offs.push_back(0);
+		return offs;
+	}
+
+	const struc_t* struc = get_struc(tid);
+	if (struc == nullptr)
+		return offs;
+	for (uint32 i = 0; i < struc->memqty; i++)
+	{
+		const member_t* member = &struc->members[i];
+		tinfo_t tinfo;
+		if (get_member_tinfo(&tinfo, member)
+			&& tinfo.is_struct()
+			&& tinfo.get_type_name(&name)
+			&& is_addr_name(name))
+		{
+			offs.push_back(asize_t(member->soff));
+		}
+	}
+	return offs;
+}
+
+// ---------------------------------------------------------------------------
+size_t struc_refs_t::run(const std::function<ea_t(ea_t)>& xlat)
+{
+	if (rescan || !changed.empty())
+		mark_instances();
+
+	size_t added = 0;
+	std::set<ea_t> todo;
+	todo.swap(dirty);
+	for (ea_t ea : todo)
+	{
+		flags64_t F = get_flags(ea);
+		if (!is_struct(F) || get_item_head(ea) != ea)
+			continue;
+		opinfo_t op = opinfo_t();
+		if (get_opinfo(&op, ea, 0, F) == nullptr || op.tid == BADADDR)
+			continue;
+		const qvector<asize_t>& offs = addr_offsets(op.tid);
+		asize_t ssize = get_struc_size(op.tid);
+		if (offs.empty() || ssize == 0)
+			continue;
+		items++;
+
+		// Every element of an array of them
+		asize_t isize = get_item_size(ea);
+		for (asize_t base = 0; base + ssize <= isize; base += ssize)
+		{
+			for (asize_t off : offs)
+			{
+				ea_t at = ea + base + off;
+				ea_t addr = ea_t(get_byte(at + 2)) << 16 | get_word(at);
+				addr = xlat(addr);
+				if (addr == BADADDR)
+					continue;
+				add_dref(ea, addr, dr_R);
+				added++;
+			}
+		}
+	}
+	refs += uint32(added);
+	return added;
+}
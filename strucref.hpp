@@ -0,0 +1,80 @@
+#ifndef __STRUCREF_HPP__
+#define __STRUCREF_HPP__
+
+#include <pro.h>
+#include <functional>
+#include <map>
+#include <set>
+
+// Data references from the 'addr' members of structures.
+//
+// A structure named 'addr' holds a 24-bit bus address, and data of that
+// type, or of a structure with 'addr' members, references what they
+// point to. The references used to be added whenever the data was
+// printed; they are now added once, after the type is applied to the
+// data or changed, when auto-analysis is done. The offsets of the
+// 'addr' members are worked out once per structure, until it changes;
+// the items of a structure that changed are then found again, and get
+// the references of its new members.
+
+class struc_refs_t
+{
+public:
+	/**
+	 * Flag the item at 'ea' as needing its references.
+	 */
+	void mark(ea_t ea);
+
+	/**
+	 * Add the references of the marked items, translating the
+	 * addresses with 'xlat'.
+	 *
+	 * returns : The number of references added.
+	 */
+	size_t run(const std::function<ea_t(ea_t)>& xlat);
+
+	/**
+	 * Offsets of the 'addr' members of the structure 'tid', or 0
+	 * if it is 'addr' itself.
+	 */
+	const qvector<asize_t>& addr_offsets(tid_t tid);
+
+	/**
+	 * Flag all the items of structure types, for databases that
+	 * were created before the references were added here.
+	 */
+	void mark_all() { rescan = true; }
+
+	/**
+	 * Forget the offsets of 'tid', after its members changed, and
+	 * flag its items.
+	 */
+	void invalidate(tid_t tid) { offsets.erase(tid); changed.insert(tid); }
+
+	/**
+	 * Forget the offsets of 'tid', which is being deleted.
+	 */
+	void forget(tid_t tid) { offsets.erase(tid); }
+
+	/**
+	 * Forget all the offsets, and flag all the items, after a
+	 * structure was renamed.
+	 */
+	void invalidate() { offsets.clear(); rescan = true; }
+
+	void clear() { dirty.clear(); offsets.clear(); changed.clear(); rescan = false; }
+
+	uint32 items = 0;  // Items whose references were added
+	uint32 refs = 0;   // References added
+	uint32 builds = 0; // Structures whose offsets were worked out
+
+private:
+	std::set<ea_t> dirty;
+	std::map<tid_t, qvector<asize_t> > offsets;
+	std::set<tid_t> changed; // Whose items are to be found
+	bool rescan = false;     // All the items are
+
+	void mark_instances();
+};
+
+#endif
@@ -0,0 +1,114 @@
+#include "m65816.hpp"
+
+// ---------------------------------------------------------------------------
+// A PHP in the first 4 instructions, and a PLP in the last 4
+static bool is_func_wrapped(ea_t start, ea_t end) {
+	head_index_t& heads = get_head_index();
+	bool is_stacked = false, is_wrapped = false;
+
+	ea_t cur = start;
+	for (int x = 0; x < 4 && cur != BADADDR; x++) {
+		if (get_opcode_info(get_byte(cur)).itype == M65816_php) {
+			is_stacked = true;
+			break;
+		}
+		cur = heads.next(cur, end);
+	}
+
+	if (is_stacked) {
+		cur = heads.prev_n(end, 4);
+		if (cur == BADADDR || cur < start)
+			cur = start;
+		for (; cur != BADADDR; cur = heads.next(cur, end)) {
+			if (heads.is_code(cur) && get_opcode_info(get_byte(cur)).itype == M65816_plp) {
+				is_wrapped = true;
+				break;
+			}
+		}
+	}
+
+	return is_wrapped;
+}
+
+// ---------------------------------------------------------------------------
+const func_summary_t& func_summaries_t::get(func_t* pfn)
+{
+	std::map<ea_t, func_summary_t>::iterator it = summaries.find(pfn->start_ea);
+	if (it != summaries.end())
+	{
+		hits++;
+		return it->second;
+	}
+	misses++;
+
+	// Until the dataflow pass has run on the function,
+	// take the flags of its last byte as the exit state
+	func_summary_t s = {};
+	if (is_func_wrapped(pfn->start_ea, pfn->end_ea))
+		s.flags |= FS_WRAPPED;
+	s.entry = uint16(get_pstate(pfn->start_ea));
+	s.exit = uint16(get_pstate(pfn->end_ea - 1));
+	s.exit_mask = PS_M | PS_X;
+	s.db_kind = MXR_ENTRY;
+	s.dp_kind = MXR_ENTRY;
+
+	set(pfn->start_ea, s);
+	return summaries[pfn->start_ea];
+}
+
+// ---------------------------------------------------------------------------
+void func_summaries_t::set(ea_t start_ea, const func_summary_t& summary)
+{
+	std::map<ea_t, func_summary_t>::iterator it = summaries.find(start_ea);
+	if (it != summaries.end() && memcmp(&it->second, &summary, sizeof(summary)) == 0)
+		return;
+	summaries[start_ea] = summary;
+	gen++;
+	changed.insert(std::make_pair(start_ea, false));
+	node.supset_ea(start_ea, &summary, sizeof(summary), FUNC_SUMMARY_TAG);
+}
+
+// ---------------------------------------------------------------------------
+void func_summaries_t::invalidate(ea_t ea)
+{
+	func_t* pfn = get_func(ea);
+	if (pfn == nullptr)
+		return;
+	if (summaries.erase(pfn->start_ea) != 0)
+	{
+		gen++;
+		changed[pfn->start_ea] = true;
+		node.supdel_ea(pfn->start_ea, FUNC_SUMMARY_TAG);
+	}
+}
+
+// ---------------------------------------------------------------------------
+void func_summaries_t::invalidate(ea_t ea1, ea_t ea2)
+{
+	// Each chunk in the range, tails included; invalidate()
+	// finds the function owning it
+	func_t* chunk = get_fchunk(ea1);
+	if (chunk == nullptr)
+		chunk = get_next_fchunk(ea1);
+	while (chunk != nullptr && chunk->start_ea < ea2)
+	{
+		invalidate(chunk->start_ea);
+		chunk = get_next_fchunk(chunk->start_ea);
+	}
+}
+
+// ---------------------------------------------------------------------------
+void func_summaries_t::load()
+{
+	summaries.clear();
+	changed.clear();
+	gen++;
+	for (nodeidx_t idx = node.supfirst(FUNC_SUMMARY_TAG);
+		idx != BADNODE;
+		idx = node.supnext(idx, FUNC_SUMMARY_TAG))
+	{
+		func_summary_t s;
+		if (node.supval(idx, &s, sizeof(s), FUNC_SUMMARY_TAG) == sizeof(s))
+			summaries[node2ea(idx)] = s;
+	}
+}
@@ -0,0 +1,92 @@
+#ifndef __SUMMARY_HPP__
+#define __SUMMARY_HPP__
+
+#include <pro.h>
+#include <funcs.hpp>
+#include <netnode.hpp>
+#include <map>
+
+// What a caller needs to know about a function's effect on the
+// M/X/E flags.
+//
+// emu() used to work this out at every JSR/JSL, by decoding the
+// first and last instructions of the callee to see whether it is
+// wrapped in PHP/PLP, and reading its flags at both ends. Summaries
+// are computed once per function, kept in the helper netnode, and
+// dropped when the function's code or flags change.
+
+enum func_summary_flags_t
+{
+	FS_WRAPPED = 0x01, // Starts with PHP and ends with PLP
+	FS_PASS = 0x02     // Exit state comes from the dataflow pass (see mx_flow_t)
+};
+
+struct func_summary_t
+{
+	uint8 flags;      // OR'd func_summary_flags_t
+	uint8 reserved;
+	uint16 entry;     // PS_* flags the function was analyzed with
+	uint16 exit;      // PS_* flags on return
+	uint16 exit_mask; // Which of the 'exit' flags are known
+	uint8 db_kind;    // mx_reg_kind_t of DB on return
+	uint8 dp_kind;    // mx_reg_kind_t of D on return
+	uint16 exit_db;   // DB on return, if db_kind is MXR_CONST
+	uint16 exit_dp;   // D on return, if dp_kind is MXR_CONST
+};
+
+// Flags a call to the function is expected to change: those
+// that differ between entry and exit, unless it saves them.
+inline uint16 func_summary_changes(const func_summary_t& s)
+{
+	return (s.flags & FS_WRAPPED) ? 0 : s.exit_mask & (s.entry ^ s.exit);
+}
+
+// Netnode tag of the summaries, indexed by function start
+#define FUNC_SUMMARY_TAG 'F'
+
+class func_summaries_t
+{
+public:
+	func_summaries_t(netnode& node) : node(node) {}
+
+	/**
+	 * Summary of 'pfn', computed if it isn't known yet.
+	 */
+	const func_summary_t& get(func_t* pfn);
+
+	/**
+	 * Replace the summary of the function starting at 'start_ea'.
+	 */
+	void set(ea_t start_ea, const func_summary_t& summary);
+
+	/**
+	 * Drop the summary of the function containing 'ea'.
+	 */
+	void invalidate(ea_t ea);
+
+	/**
+	 * Drop the summaries of all functions with code in [ea1, ea2).
+	 */
+	void invalidate(ea_t ea1, ea_t ea2);
+
+	/**
+	 * Reload all summaries from the netnode.
+	 */
+	void load();
+
+	uint32 hits = 0;
+	uint32 misses = 0;
+
+	// Incremented whenever a summary is changed or dropped
+	uint32 gen = 0;
+
+	// Starts of the summaries changed (false) or dropped (true)
+	// since call_graph_t last ran
+	std::map<ea_t, bool> changed;
+
+private:
+	netnode& node;
+	std::map<ea_t, func_summary_t> summaries;
+};
+
+#endif
@@ -2,9 +2,11 @@
 #ifndef __UTIL_HPP__
 #define __UTIL_HPP__
 
+#include <algorithm>
+
 #include "m65816.hpp"
 #include "struct.hpp"
-#include "ida/gaia_cop.hpp"
+#include "copdesc.hpp"
 
 #define MAX_OFFSET  0x6000L
 //#define DEFAULT_BASE 0x800000L
@@ -59,65 +61,47 @@ static inline ea_t ea_map_code(const insn_t& insn, ea_t ea) {
 //}
 
 
-static void xfer_sreg(ea_t from, ea_t to, int rg, bool is_call = false) {
+static void xfer_sreg(ea_t from, ea_t to, int rg) {
 	sel_t val;
 
 	if (rg == rPB)
 		val = (to >> 16) & 0xFF;
 
-	else if (rg == rFm || rg == rFx) {
-
-		sreg_range_t range, other;
-		int org = rg == rFm ? rOm : rOx;
-
-		bool has_range = get_sreg_range(&range, from, rg);
-		bool has_other = get_sreg_range(&other, from, org);
-
-		if (has_range) {
-			if (has_other) {
-				if (other.start_ea > range.start_ea)
-					goto OTH;
-				else if (range.start_ea > other.start_ea) {}
-				else if (range.val == other.val)
-					return; //Do nothing
-				else if (other.val)
-					goto OTH;
-			}
-			val = range.val;
-		}
-		else if (has_other) {
-		OTH:
-			rg = org;
-			val = other.val;
-		}
-		else
-			val = 0;
+	else if (rg == rP) {
+		// Don't let a propagated state replace one that was
+		// set by an instruction or by the user at that address
+		sreg_range_t cur;
+		bool has_cur = read_sreg_range(&cur, to, rP);
+		if (has_cur && cur.start_ea == to
+			&& (cur.tag == SR_user || (cur.val & PS_ORG_MASK) == PS_ORG_INSN))
+			return;
+
+		// Nothing to do if the flags already match
+		sel_t flags = get_pstate(from);
+		if (has_cur && cur.val != BADSEL && (cur.val & PS_FLAGS) == flags)
+			return;
+		val = flags | PS_ORG_FLOW;
 	}
+	else if (rg == rB)
+		val = get_cpu_mode(from).db;
+	else if (rg == rD)
+		val = get_cpu_mode(from).dp;
 	else
-		val = get_sreg(from, rg);
+		val = read_sreg(from, rg);
 
-	////Do nothing if there is no change
-	//if (!is_call) {
-	//	sel_t cur = get_sreg(to, rg);
-	//	if (val == cur)
-	//		return;
-	//}
-
-RET:
-	split_sreg_range(to, rg, val, SR_auto);
+	split_sreg(to, rg, val);
 }
 
 static inline void xfer_sreg(const insn_t& insn, ea_t to, int rg) {
-	xfer_sreg(insn.ea, to, rg, is_call_insn(insn));
+	xfer_sreg(insn.ea, to, rg);
 }
 
-static void xfer_sregs_short(ea_t from, ea_t to, bool is_call = false) {
-	xfer_sreg(from, to, rFm, is_call);
-	xfer_sreg(from, to, rFx, is_call);
+static void xfer_sregs_short(ea_t from, ea_t to) {
+	xfer_sreg(from, to, rP);
 }
 
 static inline void xfer_sregs_short(const insn_t& insn, ea_t to) {
-	xfer_sregs_short(insn.ea, to, is_call_insn(insn));
+	xfer_sregs_short(insn.ea, to);
 }
 
 /// <summary>
@@ -125,141 +109,124 @@ static inline void xfer_sregs_short(const insn_t& insn, ea_t to) {
 /// </summary>
 /// <param name="insn"></param>
 /// <param name="ea"></param>
-static void xfer_sregs(ea_t from, ea_t to, bool is_call = false) {
-	xfer_sreg(from, to, rFm, is_call);
-	xfer_sreg(from, to, rFx, is_call);
-	xfer_sreg(from, to, rFe, is_call);
-	xfer_sreg(from, to, rPB, is_call);
-	xfer_sreg(from, to, rB, is_call);
-	xfer_sreg(from, to, rDs, is_call);
-	xfer_sreg(from, to, rD, is_call);
+static void xfer_sregs(ea_t from, ea_t to) {
+	xfer_sreg(from, to, rP);
+	xfer_sreg(from, to, rPB);
+	xfer_sreg(from, to, rB);
+	xfer_sreg(from, to, rDs);
+	xfer_sreg(from, to, rD);
 }
 
 static inline void xfer_sregs(const insn_t& insn, ea_t to) {
-	xfer_sregs(insn.ea, to, is_call_insn(insn));
+	xfer_sregs(insn.ea, to);
 }
 
-static void xfer_sreg_return(const insn_t& insn, func_t* func, int rg) {
-
-	ea_t to = insn.ea + insn.size;
-
-	if (to == 0xC2A6B7) {
-		msg("");
-	}
-
-	sel_t old = get_sreg(insn.ea, rg);
-	sel_t near = get_sreg(func->start_ea, rg);
-	sel_t far0 = get_sreg(func->end_ea, rg);
-	sel_t far1 = get_sreg(func->end_ea - 1, rg);
-	sel_t far2 = get_sreg(func->end_ea - 2, rg);
-
+/// <summary>
+/// Checks an entry of a jump table whose size is not known. The table ends where an entry looks wrong.
+/// </summary>
+/// <param name="insn">Original instruction referencing the jump table</param>
+/// <param name="ea">Address for current entry in the jump table</param>
+/// <param name="near">Nearest target after the table so far, which the table can't run into</param>
+/// <param name="ref">Receives the target of the entry</param>
+/// <returns>Returns true if the entry looks valid</returns>
+static bool scan_jt_offset(const insn_t& insn, ea_t ea, ea_t& near, ea_t* ref) {
+	//Read entry value
+	*ref = ea_map_code(insn, ea);
 
-	if (near != far1 && far1 != old) {
-		split_sreg_range(to, rg, far1, SR_auto);
-	}
-}
+	//Tables come before the code they point to
+	if (*ref <= ea)
+		return false;
 
-static bool is_func_wrapped(ea_t start, ea_t end) {
-	ea_t cur = start;
-	bool is_stacked = false, is_wrapped = false;
-	insn_t ins = insn_t();
+	//Ran into a target
+	if (near != 0 && ea + 1 >= near)
+		return false;
 
-	for (int x = 0; x < 4; x++) {
-		decode_insn(&ins, cur);
-		if (ins.itype == M65816_php) {
-			is_stacked = true;
-			break;
-		}
-		cur += ins.size;
-	}
+	//Validate distance
+	if (ea_dist(ea, *ref) > MAX_OFFSET)
+		return false;
 
-	if (is_stacked) {
-		cur = end;
-		for (int x = 0; x < 4; x++) {
-			cur = decode_prev_insn(&ins, cur);
-			if (ins.itype == M65816_plp) {
-				is_wrapped = true;
-				break;
-			}
-		}
-	}
+	if (near == 0 || *ref < near)
+		near = *ref;
 
-	return is_wrapped;
+	return true;
 }
 
-
-static void xfer_sregs_return(const insn_t& insn, func_t* func) {
-
-	//If register is pushed and popped, do nothing
-	if (!is_func_wrapped(func->start_ea, func->end_ea))
-	{
-		xfer_sreg_return(insn, func, rFm);
-		xfer_sreg_return(insn, func, rFx);
-	}
+/// <summary>
+/// Test whether a code reference from one address to another already exists
+/// </summary>
+/// <param name="from"></param>
+/// <param name="to"></param>
+/// <returns></returns>
+static bool has_cref(ea_t from, ea_t to) {
+	xrefblk_t xb;
+	for (bool ok = xb.first_from(from, XREF_ALL); ok; ok = xb.next_from())
+		if (xb.iscode && xb.to == to)
+			return true;
+	return false;
 }
 
 /// <summary>
-/// Process a jump table entry, creating the data offset and code reference
+/// Creates a whole jump table at once: the offsets (as one word array when the entries follow each other),
+/// the code references that are missing, and the segment registers of each distinct target, once
 /// </summary>
 /// <param name="insn">Original instruction referencing the jump table</param>
-/// <param name="ea">Address for current entry in the jump table</param>
-/// <returns>Returns true if success, otherwise false</returns>
-static bool make_jt_offset(const insn_t& insn, ea_t ea, ea_t& near) {
-	//Read entry value
-	ea_t ref = ea_map_code(insn, ea);
-
-	if (ref <= ea)
-	{
-		msg("reverse ref 0x%04X -> 0x%04X -> 0x%04X\n", insn.ea, ea, ref);
-		return false;
-	}
-
-	if (near != 0 && ea + 1 >= near)
-	{
-		msg("bump 0x%04X -> 0x%04X -> 0x%04X\n", insn.ea, ea, ref);
-		return false;
+/// <param name="entries">Entry addresses and their targets, in table order</param>
+/// <param name="step">Distance between entries</param>
+/// <returns>Returns the number of entries created</returns>
+static size_t make_jt_offsets(const insn_t& insn, const qvector<std::pair<ea_t, ea_t> >& entries, uint32 step) {
+	if (entries.empty())
+		return 0;
+
+	//Create data offsets, unless it was done by a previous pass: one array
+	//of offsets covering the table, or an offset at every entry
+	size_t count = entries.size();
+	ea_t first = entries[0].first;
+	flags64_t F = get_flags(first);
+	bool done = step == 2 && is_head(F) && is_off(F, 0) && get_item_size(first) >= 2 * count;
+	if (!done) {
+		done = true;
+		for (const auto& e : entries)
+			done = done && is_off(get_flags(e.first), 0);
 	}
-
-	//Validate distance
-	if (ea_dist(ea, ref) > MAX_OFFSET)
-	{
-		msg("distance too far 0x%04X -> 0x%04X -> 0x%04X\n", insn.ea, ea, ref);
-		return false; //To continue or not...
+	if (!done) {
+		if (step != 2 || !create_word(first, 2 * count) || !ea_make_offset(first)) {
+			for (count = 0; count < entries.size(); count++)
+				if (!ea_make_offset(entries[count].first))
+					break;
+		}
 	}
 
-	//Create data offset
-	if (!ea_make_offset(ea))
-	{
-		msg("make_offset failed 0x%04X -> 0x%04X -> 0x%04X\n", insn.ea, ea, ref);
-		return false;
+	//Add code references
+	cref_t type = is_call_insn(insn) ? fl_CN : fl_JN;
+	eavec_t targets;
+	for (size_t i = 0; i < count; i++) {
+		const auto& e = entries[i];
+		if (!has_cref(e.first, e.second) && !add_cref(e.first, e.second, type)) {
+			count = i;
+			break;
+		}
+		targets.push_back(e.second);
 	}
 
-	//Add code reference
-	if (add_cref(ea, ref, is_call_insn(insn) ? fl_CN : fl_JN)) {
-		//Update segment registers at new address
+	//Update segment registers at each new address, once
+	std::sort(targets.begin(), targets.end());
+	targets.erase(std::unique(targets.begin(), targets.end()), targets.end());
+	for (ea_t ref : targets)
 		xfer_sregs(insn, ref);
 
-		if (near == 0 || (ref > ea && ref < near))
-			near = ref;
-
-		return true;
-	}
-
-	msg("add_cref failed 0x%04X -> 0x%04X -> 0x%04X\n", insn.ea, ea, ref);
-	return false;
+	return count;
 }
 
 static bool should_stop_flow(const insn_t& insn) {
 	if (insn.itype == M65816_cop) {
-		const cop_def& def = cop_lst[insn.ops[0].value & 0xFF];
-		return def.noret;
+		return get_cop_desc(insn.ops[0].value & 0xFF).noret;
 	}
 	return false;
 }
 
 
 /// <summary>
-/// 
+/// Reads and checks the whole table first, sized by jt_find_bound() when X is bounded, then creates it in one go
 /// </summary>
 /// <param name="insn"></param>
 /// <param name="x"></param>
@@ -267,12 +234,39 @@ static bool should_stop_flow(const insn_t& insn) {
 static bool handle_jump_table(const insn_t& insn, const op_t& x) {
 
 	if (insn.itype == M65816_jsr || insn.itype == M65816_jmp) {
+		jt_stats_t& stats = GET_MODULE_DATA(m65816_t)->jtstats;
 		ea_t ea = map_code_ea(insn, x);
 
-		ea_t cur = ea, near = 0;
-		while (make_jt_offset(insn, cur, near))
-			cur += 2;
+		//Entry address, target
+		qvector<std::pair<ea_t, ea_t> > entries;
+
+		uint32 bound_step = 2;
+		jt_bound_t bound;
+		if (jt_find_bound(insn.ea, &bound)) {
+			bound_step = bound.step;
+			stats.bounded++;
+			for (uint32 i = 0, n = jt_entry_count(bound); i < n; i++) {
+				ea_t cur = ea + bound.lo + i * bound.step;
+				ea_t ref = ea_map_code(insn, cur);
+
+				//All of it, or none
+				if (!is_mapped(cur) || !is_mapped(ref)) {
+					stats.rejected++;
+					return true;
+				}
+				entries.push_back(std::make_pair(cur, ref));
+			}
+		}
+		else {
+			stats.unbounded++;
+			ea_t cur = ea, near = 0, ref;
+			while (entries.size() < JT_MAX_ENTRIES && scan_jt_offset(insn, cur, near, &ref)) {
+				entries.push_back(std::make_pair(cur, ref));
+				cur += 2;
+			}
+		}
 
+		stats.entries += uint32(make_jt_offsets(insn, entries, bound_step));
 
 		//TODO: Make subroutine chunk
 		return true;
@@ -305,7 +299,7 @@ static uint64 get_next_triple(insn_t& insn) {
 }
 
 /// <summary>
-/// Extends instruction out to multiple operands based on the COP command byte, using cop_lst as the definition
+/// Extends instruction out to multiple operands based on the COP command byte, using the slots of the database's COP dialect
 /// </summary>
 /// <param name="insn"></param>
 static bool process_cop(insn_t& insn) {
@@ -315,60 +309,36 @@ static bool process_cop(insn_t& insn) {
 
 	//Get definition
 	op_t* op = insn.ops;
-	const cop_def& def = cop_lst[op->value];
+	const cop_desc_t& desc = get_cop_desc(op->value & 0xFF);
 
 	//Sanity check
-	if (def.op != op->value)
+	if (!desc.valid)
 		return false;
 
-	//Iterate through the command bytes
-	for (char ix = 0, off = 1, cmd = -1; ix < 8 && cmd != 0; op++, cmd = def.mem[ix++]) {
-		switch (cmd) {
-
-		case -1: break; //Start
+	//Command byte
+	op->type = o_cop;
+	op->offb = 1;
 
-		case 'b': //Byte
-			op->value = insn.get_next_byte();
-			op->dtype = dt_byte;
-			break;
+	//Arguments
+	for (int ix = 0; ix < desc.nslots; ix++) {
+		const cop_slot_t& slot = desc.slots[ix];
+		op++;
 
-		case 'c': //Code
+		uint64 val = slot.width == 3 ? get_next_triple(insn)
+			: slot.width == 2 ? insn.get_next_word() : insn.get_next_byte();
+		if (slot.addr)
+			op->addr = val;
+		else
+			op->value = val;
+		if (slot.code)
 			op->specflag3 = 1; //Flag code
-		case 'o': //Offset
-			op->addr = insn.get_next_word();
-			goto INC;
-
-		case 'w': //Short word
-			op->value = insn.get_next_word();
-		INC:
-			op->dtype = dt_word;
-			break;
 
-		case 'C': //Long code
-			op->specflag3 = 1; //Flag code
-		case 'O': //Long offset
-			op->addr = get_next_triple(insn);
-			goto WIDE;
-
-		case 'W': //Long word
-			op->value = get_next_triple(insn);
-		WIDE:
-			op->dtype = dt_dword;
-			break;
-
-		default: goto NEXT; //Invalid command
-		}
-
-		//Assign common fields
+		op->dtype = slot.width == 3 ? dt_dword
+			: slot.width == 2 ? dt_word : dt_byte;
 		op->type = o_cop;
-		op->offb = off;
-
-		//Increment offset
-		off += op->dtype == dt_dword ? 3
-			: op->dtype == dt_word ? 2 : 1;
+		op->offb = slot.offb;
 	}
 
-NEXT:
 	return true; //Done
 }
 
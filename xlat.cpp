@@ -0,0 +1,103 @@
+#include "m65816.hpp"
+
+// ---------------------------------------------------------------------------
+// Whether 'offset' into the page is where 'base' says it should be
+static bool xlat_follows(const std::function<ea_t(ea_t)>& slow, ea_t start, ea_t base, ea_t offset)
+{
+	ea_t ea = slow(start + offset);
+	return base == BADADDR ? ea == BADADDR : ea == base + offset;
+}
+
+// ---------------------------------------------------------------------------
+void xlat_table_t::build(const std::function<ea_t(ea_t)>& slow)
+{
+	linear = 0;
+	mismatches = 0;
+	reverse.clear();
+	for (uint32 i = 0; i < XLAT_PAGES; i++)
+	{
+		page_t& page = pages[i];
+		ea_t start = ea_t(i) << XLAT_PAGE_BITS;
+		page.base = slow(start);
+
+		// Every address: a window mapped elsewhere can be anywhere
+		// in the page ($2100-$21FF in bank 00's $2000-$2FFF, say)
+		page.linear = true;
+		for (ea_t off = 1; off < XLAT_PAGE_SIZE; off++)
+		{
+			if (!xlat_follows(slow, start, page.base, off))
+			{
+				page.linear = false;
+				break;
+			}
+		}
+
+		if (page.linear)
+			linear++;
+
+		// Under each page of the database it overlaps
+		if (page.linear && page.base != BADADDR)
+		{
+			alias_t alias = { start, page.base };
+			reverse[page.base >> XLAT_PAGE_BITS].push_back(alias);
+			if ((page.base & (XLAT_PAGE_SIZE - 1)) != 0)
+				reverse[(page.base >> XLAT_PAGE_BITS) + 1].push_back(alias);
+		}
+	}
+	valid = true;
+
+#ifdef _DEBUG
+	// Both ways over the whole bus, for the mapper at hand
+	ea_t sink = 0;
+	uint64 t0 = get_nsec_stamp();
+	for (ea_t address = 0; address < 0x1000000; address++)
+		sink += slow(address);
+	uint64 t1 = get_nsec_stamp();
+	for (ea_t address = 0; address < 0x1000000; address++)
+	{
+		ea_t ea;
+		if (!lookup(address, &ea))
+			ea = slow(address);
+		sink -= ea;
+	}
+	uint64 t2 = get_nsec_stamp();
+	qnotused(sink);
+
+	for (ea_t address = 0; address < 0x1000000; address++)
+	{
+		ea_t ea;
+		if (lookup(address, &ea) && ea != slow(address))
+			mismatches++;
+	}
+	msg("m65816: xlat table: %u of %u pages linear, %.1f ns per address through the mapper, "
+		"%.1f through the table, %u mismatches\n",
+		linear, XLAT_PAGES, double(t1 - t0) / 0x1000000, double(t2 - t1) / 0x1000000, mismatches);
+#endif
+}
+
+// ---------------------------------------------------------------------------
+size_t xlat_table_t::aliases(ea_t ea, eavec_t* out) const
+{
+	out->clear();
+	std::unordered_map<ea_t, qvector<alias_t> >::const_iterator it = reverse.find(ea >> XLAT_PAGE_BITS);
+	if (it == reverse.end())
+		return 0;
+
+	// Pages were added in bus order
+	for (const alias_t& alias : it->second)
+		if (ea >= alias.base && ea < alias.base + XLAT_PAGE_SIZE)
+			out->push_back(alias.bus + (ea - alias.base));
+	return out->size();
+}
+
+// ---------------------------------------------------------------------------
+ea_t xlat_table_t::bus_addr(ea_t ea) const
+{
+	eavec_t all;
+	if (aliases(ea, &all) == 0)
+		return BADADDR;
+	for (ea_t bus : all)
+		if (bus == ea)
+			return ea;
+	return all[0];
+}
@@ -0,0 +1,86 @@
+#ifndef __XLAT_HPP__
+#define __XLAT_HPP__
+
+#include <pro.h>
+#include <functional>
+#include <unordered_map>
+
+// Page table in front of snes_addr_t::xlat().
+//
+// Bus addresses are translated for each operand emulated and printed,
+// and the loader's xlat() works it out from the mapper every time.
+// The SNES maps memory in blocks of at least 4K, so the translation is
+// worked out once per 4K page of the 24-bit bus: a page that maps to
+// consecutive addresses (mirrors included) is translated with one
+// load and an add. Pages that don't are left to xlat().
+//
+// A page is only kept if every address in it follows from the first.
+// Debug builds then time both ways over the whole bus, and check that
+// they agree.
+//
+// The same pages, indexed by where they land, give the way back: the
+// bus addresses (mirrors) an address of the database is seen at. Only
+// the pages in the table are indexed.
+
+#define XLAT_PAGE_BITS 12
+#define XLAT_PAGE_SIZE (1 << XLAT_PAGE_BITS)
+#define XLAT_PAGES (0x1000000 >> XLAT_PAGE_BITS)
+
+class xlat_table_t
+{
+public:
+	/**
+	 * Rebuild the table from 'slow', the translation it stands for.
+	 */
+	void build(const std::function<ea_t(ea_t)>& slow);
+
+	void clear() { valid = false; reverse.clear(); }
+
+	/**
+	 * Translate 'address', if its page is in the table.
+	 */
+	bool lookup(ea_t address, ea_t* out) const
+	{
+		if (!valid || address >= 0x1000000)
+			return false;
+		const page_t& page = pages[address >> XLAT_PAGE_BITS];
+		if (!page.linear)
+			return false;
+		*out = page.base == BADADDR ? BADADDR : page.base + (address & (XLAT_PAGE_SIZE - 1));
+		return true;
+	}
+
+	/**
+	 * Bus addresses that translate to 'ea', lowest first.
+	 */
+	size_t aliases(ea_t ea, eavec_t* out) const;
+
+	/**
+	 * The bus address of 'ea': 'ea' itself if it translates to itself,
+	 * otherwise its lowest alias. BADADDR if there is none.
+	 */
+	ea_t bus_addr(ea_t ea) const;
+
+	uint32 linear = 0;     // Pages in the table, in the last build
+	uint32 mismatches = 0; // Addresses the table got wrong, in the debug check
+
+private:
+	struct page_t
+	{
+		ea_t base;   // Translation of the first address, or BADADDR if unmapped
+		bool linear; // The rest of the page follows
+	};
+
+	// A page of the bus, by where it lands
+	struct alias_t
+	{
+		ea_t bus;    // Start of the page
+		ea_t base;   // Its translation
+	};
+
+	page_t pages[XLAT_PAGES];
+	std::unordered_map<ea_t, qvector<alias_t> > reverse; // By ea >> XLAT_PAGE_BITS
+	bool valid = false;
+};
+
+#endif